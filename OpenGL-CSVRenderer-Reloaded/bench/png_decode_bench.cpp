@@ -0,0 +1,86 @@
+// Decode benchmark: fast PNG path (stbi_load) against the stock stb_image decoder.
+//
+// build and run from the project directory:
+//    g++ -O2 bench/png_decode_bench.cpp stb_image.cpp -o png_decode_bench
+//    ./png_decode_bench [file.png ...]
+//
+// without arguments the shipped textures/*.png are used. Every image is also checked to
+// decode to exactly the same pixels through both paths.
+#include "../stb_image.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" stbi_uc *stbi__stock_load(char const *filename, int *x, int *y, int *comp, int req_comp);
+
+typedef stbi_uc *(*LoadFunc)(char const *, int *, int *, int *, int);
+
+// best-of-N milliseconds for one decode
+double timeDecode(LoadFunc load, const std::string &file, int iterations)
+{
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++)
+    {
+        int w, h, n;
+        auto start = std::chrono::high_resolution_clock::now();
+        stbi_uc *data = load(file.c_str(), &w, &h, &n, STBI_rgb_alpha);
+        auto end = std::chrono::high_resolution_clock::now();
+        stbi_image_free(data);
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        if (ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+bool sameOutput(const std::string &file, int reqComp)
+{
+    int w1, h1, n1, w2, h2, n2;
+    stbi_uc *a = stbi_load(file.c_str(), &w1, &h1, &n1, reqComp);
+    stbi_uc *b = stbi__stock_load(file.c_str(), &w2, &h2, &n2, reqComp);
+    bool same = a && b && w1 == w2 && h1 == h2 && n1 == n2 &&
+                std::memcmp(a, b, (size_t)w1 * h1 * (reqComp ? reqComp : n1)) == 0;
+    stbi_image_free(a);
+    stbi_image_free(b);
+    return same;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+        files.push_back(argv[i]);
+    if (files.empty())
+        files = {"textures/2brick.png", "textures/3brick.png", "textures/brick.png", "textures/bricks.png", "textures/grass.png"};
+
+    const int iterations = 20;
+    bool allSame = true;
+    double stockTotal = 0.0, fastTotal = 0.0;
+
+    std::cout << "file                          stock ms    fast ms   speedup" << std::endl;
+    for (const std::string &file : files)
+    {
+        bool same = true;
+        for (int flip = 0; flip < 2; flip++)
+        {
+            stbi_set_flip_vertically_on_load(flip);
+            for (int reqComp = 0; reqComp <= 4; reqComp++)
+                same = same && sameOutput(file, reqComp);
+        }
+        stbi_set_flip_vertically_on_load(1);
+        allSame = allSame && same;
+
+        double stock = timeDecode(stbi__stock_load, file, iterations);
+        double fast = timeDecode(stbi_load, file, iterations);
+        stockTotal += stock;
+        fastTotal += fast;
+        printf("%-28s %9.3f  %9.3f   %6.2fx%s\n", file.c_str(), stock, fast, stock / fast, same ? "" : "   MISMATCH");
+    }
+    printf("%-28s %9.3f  %9.3f   %6.2fx\n", "total", stockTotal, fastTotal, stockTotal / fastTotal);
+
+    return allSame ? 0 : 1;
+}
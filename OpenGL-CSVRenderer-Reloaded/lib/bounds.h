@@ -0,0 +1,91 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cmath>
+
+// axis-aligned bounding box
+struct AABB
+{
+    glm::vec3 Min;
+    glm::vec3 Max;
+};
+
+struct BoundingSphere
+{
+    glm::vec3 Center;
+    float Radius;
+};
+
+// bounding box of 'count' vertices whose positions are the first three floats of every
+// 'stride' floats; empty meshes get a degenerate box at the origin
+inline AABB computeAABB(const float *vertexes, int count, int stride)
+{
+    AABB box;
+    box.Min = glm::vec3(0.0f);
+    box.Max = glm::vec3(0.0f);
+    if (count <= 0)
+        return box;
+
+    box.Min = glm::vec3(FLT_MAX);
+    box.Max = glm::vec3(-FLT_MAX);
+    for (int i = 0; i < count; i++)
+    {
+        glm::vec3 p(vertexes[i * stride], vertexes[i * stride + 1], vertexes[i * stride + 2]);
+        box.Min = glm::min(box.Min, p);
+        box.Max = glm::max(box.Max, p);
+    }
+    return box;
+}
+
+// the box around 'box' after 'model': the center is transformed and the half extents are
+// projected onto the new axes with the absolute values of the rotation/scale part
+inline AABB transformAABB(const AABB &box, const glm::mat4 &model)
+{
+    glm::vec3 center = (box.Min + box.Max) * 0.5f;
+    glm::vec3 extent = (box.Max - box.Min) * 0.5f;
+    glm::vec3 newCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+    glm::vec3 newExtent(0.0f);
+    for (int row = 0; row < 3; row++)
+        for (int col = 0; col < 3; col++)
+            newExtent[row] += std::fabs(model[col][row]) * extent[col];
+    AABB result;
+    result.Min = newCenter - newExtent;
+    result.Max = newCenter + newExtent;
+    return result;
+}
+
+// bounding sphere of 'count' vertices laid out as for computeAABB; centered on the bounding
+// box, which is not the smallest sphere but good enough for culling and LOD selection
+inline BoundingSphere computeBoundingSphere(const float *vertexes, int count, int stride)
+{
+    BoundingSphere sphere;
+    sphere.Center = glm::vec3(0.0f);
+    sphere.Radius = 0.0f;
+    if (count <= 0)
+        return sphere;
+
+    AABB box = computeAABB(vertexes, count, stride);
+    sphere.Center = (box.Min + box.Max) * 0.5f;
+    float r2 = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        glm::vec3 d = glm::vec3(vertexes[i * stride], vertexes[i * stride + 1], vertexes[i * stride + 2]) - sphere.Center;
+        r2 = glm::max(r2, glm::dot(d, d));
+    }
+    sphere.Radius = std::sqrt(r2);
+    return sphere;
+}
+
+// the sphere after 'model'; the radius grows by the largest axis scale
+inline BoundingSphere transformSphere(const BoundingSphere &sphere, const glm::mat4 &model)
+{
+    BoundingSphere result;
+    result.Center = glm::vec3(model * glm::vec4(sphere.Center, 1.0f));
+    float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    result.Radius = sphere.Radius * scale;
+    return result;
+}
+#endif
@@ -0,0 +1,261 @@
+#ifndef BOUNDS_SOA_H
+#define BOUNDS_SOA_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "frustum.h"
+
+#include <vector>
+#include <cstddef>
+#include <cmath>
+
+// the vector kernels need GCC/Clang target attributes on x86; elsewhere only the scalar loop exists
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BOUNDS_SOA_X86
+#include <immintrin.h>
+#endif
+
+// how far outside a plane a bound must be to be culled. The compiler may fuse the
+// multiply-adds of one kernel and not of another, so the paths can round differently; with
+// this margin that only ever keeps a few extra objects that graze a plane, instead of
+// culling visible ones on some CPUs.
+// It is well above the rounding error of scenes within a few hundred units of the origin.
+const float BOUNDS_CULL_EPSILON = 1e-3f;
+
+// instruction sets the culling loop can run on, picked once at startup
+enum CullPath
+{
+    CULL_SCALAR,
+    CULL_AVX2,
+    CULL_AVX512
+};
+
+// Bounds of many objects in structure-of-arrays form, one array per component, so a
+// frustum test handles 8 (AVX2) or 16 (AVX-512) objects per instruction with plain vector
+// loads. Every entry is a box (center, half extents) plus a radius: boxes have radius 0
+// and spheres zero extents, so one formula tests both. Per plane,
+//   dot(n, center) + w + dot(|n|, extent) + radius < -BOUNDS_CULL_EPSILON
+// means the object is outside, the test of Frustum::intersects() with a small margin.
+// cull() writes the indices of the visible entries into a compact list; ranges let callers
+// split a large set across the JobPool, each chunk writing its own part of the output.
+class BoundsSoA
+{
+public:
+    std::vector<float> CenterX, CenterY, CenterZ;
+    std::vector<float> ExtentX, ExtentY, ExtentZ;
+    std::vector<float> Radius;
+
+    size_t size() const
+    {
+        return CenterX.size();
+    }
+    void clear()
+    {
+        resize(0);
+    }
+    void resize(size_t count)
+    {
+        CenterX.resize(count);
+        CenterY.resize(count);
+        CenterZ.resize(count);
+        ExtentX.resize(count);
+        ExtentY.resize(count);
+        ExtentZ.resize(count);
+        Radius.resize(count);
+    }
+
+    // appends a bound and returns its index
+    size_t add(const AABB &box)
+    {
+        resize(size() + 1);
+        set(size() - 1, box);
+        return size() - 1;
+    }
+    size_t add(const BoundingSphere &sphere)
+    {
+        resize(size() + 1);
+        set(size() - 1, sphere);
+        return size() - 1;
+    }
+    void set(size_t i, const AABB &box)
+    {
+        glm::vec3 center = (box.Min + box.Max) * 0.5f;
+        glm::vec3 extent = (box.Max - box.Min) * 0.5f;
+        store(i, center, extent, 0.0f);
+    }
+    void set(size_t i, const BoundingSphere &sphere)
+    {
+        store(i, sphere.Center, glm::vec3(0.0f), sphere.Radius);
+    }
+
+    // writes the indices in [begin, end) that intersect the frustum to 'visible', in
+    // increasing order, and returns how many there are; 'visible' needs room for end - begin
+    size_t cull(const Frustum &frustum, size_t begin, size_t end, unsigned int *visible) const
+    {
+        float planes[Frustum::PLANE_COUNT * 7];
+        packPlanes(frustum, planes);
+#ifdef BOUNDS_SOA_X86
+        CullPath path = cullPath();
+        if (path == CULL_AVX512)
+            return cullAVX512(planes, begin, end, visible);
+        if (path == CULL_AVX2)
+            return cullAVX2(planes, begin, end, visible);
+#endif
+        return cullScalar(planes, begin, end, visible);
+    }
+    // every entry; 'visible' is resized to the visible count
+    size_t cull(const Frustum &frustum, std::vector<unsigned int> &visible) const
+    {
+        visible.resize(size());
+        size_t count = visible.empty() ? 0 : cull(frustum, 0, size(), &visible[0]);
+        visible.resize(count);
+        return count;
+    }
+
+    // the widest instruction set this CPU supports
+    static CullPath cullPath()
+    {
+#ifdef BOUNDS_SOA_X86
+        static const CullPath path = __builtin_cpu_supports("avx512f") ? CULL_AVX512 : (__builtin_cpu_supports("avx2") ? CULL_AVX2 : CULL_SCALAR);
+        return path;
+#else
+        return CULL_SCALAR;
+#endif
+    }
+    static const char *cullPathName()
+    {
+        CullPath path = cullPath();
+        return path == CULL_AVX512 ? "AVX-512" : (path == CULL_AVX2 ? "AVX2" : "scalar");
+    }
+
+private:
+    void store(size_t i, const glm::vec3 &center, const glm::vec3 &extent, float radius)
+    {
+        CenterX[i] = center.x;
+        CenterY[i] = center.y;
+        CenterZ[i] = center.z;
+        ExtentX[i] = extent.x;
+        ExtentY[i] = extent.y;
+        ExtentZ[i] = extent.z;
+        Radius[i] = radius;
+    }
+
+    // per plane: nx, ny, nz, w, |nx|, |ny|, |nz|
+    static void packPlanes(const Frustum &frustum, float *planes)
+    {
+        for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+        {
+            const glm::vec4 &plane = frustum.Planes[p];
+            float *out = planes + p * 7;
+            out[0] = plane.x;
+            out[1] = plane.y;
+            out[2] = plane.z;
+            out[3] = plane.w;
+            out[4] = std::fabs(plane.x);
+            out[5] = std::fabs(plane.y);
+            out[6] = std::fabs(plane.z);
+        }
+    }
+
+    bool outside(const float *planes, size_t i) const
+    {
+        for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+        {
+            const float *n = planes + p * 7;
+            // summed in the same order as the vector kernels
+            float d = Radius[i] + n[3];
+            d += n[0] * CenterX[i];
+            d += n[1] * CenterY[i];
+            d += n[2] * CenterZ[i];
+            d += n[4] * ExtentX[i];
+            d += n[5] * ExtentY[i];
+            d += n[6] * ExtentZ[i];
+            if (d < -BOUNDS_CULL_EPSILON)
+                return true;
+        }
+        return false;
+    }
+
+    size_t cullScalar(const float *planes, size_t begin, size_t end, unsigned int *visible) const
+    {
+        size_t count = 0;
+        for (size_t i = begin; i < end; i++)
+            if (!outside(planes, i))
+                visible[count++] = (unsigned int)i;
+        return count;
+    }
+
+#ifdef BOUNDS_SOA_X86
+    // 8 entries per iteration; the lanes that pass every plane are appended bit by bit
+    __attribute__((target("avx2")))
+    size_t cullAVX2(const float *planes, size_t begin, size_t end, unsigned int *visible) const
+    {
+        const __m256 margin = _mm256_set1_ps(-BOUNDS_CULL_EPSILON);
+        size_t count = 0;
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256 cx = _mm256_loadu_ps(&CenterX[i]), cy = _mm256_loadu_ps(&CenterY[i]), cz = _mm256_loadu_ps(&CenterZ[i]);
+            __m256 ex = _mm256_loadu_ps(&ExtentX[i]), ey = _mm256_loadu_ps(&ExtentY[i]), ez = _mm256_loadu_ps(&ExtentZ[i]);
+            __m256 r = _mm256_loadu_ps(&Radius[i]);
+            __m256 out = _mm256_setzero_ps();
+            for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+            {
+                const float *n = planes + p * 7;
+                __m256 d = _mm256_add_ps(r, _mm256_set1_ps(n[3]));
+                d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(n[0]), cx));
+                d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(n[1]), cy));
+                d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(n[2]), cz));
+                d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(n[4]), ex));
+                d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(n[5]), ey));
+                d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(n[6]), ez));
+                out = _mm256_or_ps(out, _mm256_cmp_ps(d, margin, _CMP_LT_OQ));
+            }
+            unsigned int mask = ~(unsigned int)_mm256_movemask_ps(out) & 0xFFu;
+            while (mask)
+            {
+                visible[count++] = (unsigned int)i + (unsigned int)__builtin_ctz(mask);
+                mask &= mask - 1;
+            }
+        }
+        return count + cullScalar(planes, i, end, visible + count);
+    }
+
+    // 16 entries per iteration; the indices of the visible lanes are written with one
+    // compress store
+    __attribute__((target("avx512f")))
+    size_t cullAVX512(const float *planes, size_t begin, size_t end, unsigned int *visible) const
+    {
+        const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        const __m512 margin = _mm512_set1_ps(-BOUNDS_CULL_EPSILON);
+        size_t count = 0;
+        size_t i = begin;
+        for (; i + 16 <= end; i += 16)
+        {
+            __m512 cx = _mm512_loadu_ps(&CenterX[i]), cy = _mm512_loadu_ps(&CenterY[i]), cz = _mm512_loadu_ps(&CenterZ[i]);
+            __m512 ex = _mm512_loadu_ps(&ExtentX[i]), ey = _mm512_loadu_ps(&ExtentY[i]), ez = _mm512_loadu_ps(&ExtentZ[i]);
+            __m512 r = _mm512_loadu_ps(&Radius[i]);
+            __mmask16 out = 0;
+            for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+            {
+                const float *n = planes + p * 7;
+                __m512 d = _mm512_add_ps(r, _mm512_set1_ps(n[3]));
+                d = _mm512_add_ps(d, _mm512_mul_ps(_mm512_set1_ps(n[0]), cx));
+                d = _mm512_add_ps(d, _mm512_mul_ps(_mm512_set1_ps(n[1]), cy));
+                d = _mm512_add_ps(d, _mm512_mul_ps(_mm512_set1_ps(n[2]), cz));
+                d = _mm512_add_ps(d, _mm512_mul_ps(_mm512_set1_ps(n[4]), ex));
+                d = _mm512_add_ps(d, _mm512_mul_ps(_mm512_set1_ps(n[5]), ey));
+                d = _mm512_add_ps(d, _mm512_mul_ps(_mm512_set1_ps(n[6]), ez));
+                out = (__mmask16)(out | _mm512_cmp_ps_mask(d, margin, _CMP_LT_OQ));
+            }
+            __mmask16 in = (__mmask16)~out;
+            __m512i indices = _mm512_add_epi32(_mm512_set1_epi32((int)i), lanes);
+            _mm512_mask_compressstoreu_epi32(visible + count, in, indices);
+            count += (size_t)__builtin_popcount((unsigned int)in);
+        }
+        return count + cullScalar(planes, i, end, visible + count);
+    }
+#endif
+};
+#endif
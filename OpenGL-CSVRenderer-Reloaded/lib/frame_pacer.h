@@ -0,0 +1,73 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "frame_ring.h"
+
+#include <deque>
+#include <iostream>
+
+// Default number of frames the GPU may lag behind the CPU
+const unsigned int FRAMES_IN_FLIGHT = 2;
+
+// Bounds how far the CPU runs ahead of the GPU. endFrame() fences every frame after the
+// buffer swap and beginFrame() waits on the oldest fence while MaxFramesInFlight frames are
+// still queued, so the CPU prepares frame N+1 while the GPU renders frame N but never more
+// than that many frames ahead, whatever the driver does inside glfwSwapBuffers. With a
+// limit of 1 (low-latency mode) the CPU waits for the previous frame to finish before it
+// samples input, trading throughput for the shortest input-to-photon delay.
+// MaxFramesInFlight never exceeds FRAME_RING_FRAMES, so per-frame ring data is never
+// overwritten while the GPU still reads it.
+class FramePacer
+{
+public:
+    unsigned int MaxFramesInFlight;
+    // seconds the last beginFrame() blocked, i.e. how long the CPU waited for the GPU
+    double WaitTime;
+
+    FramePacer(unsigned int maxFramesInFlight = FRAMES_IN_FLIGHT) : MaxFramesInFlight(maxFramesInFlight), WaitTime(0.0)
+    {
+    }
+    ~FramePacer()
+    {
+        for (size_t i = 0; i < fences.size(); i++)
+            glDeleteSync(fences[i]);
+    }
+
+    // call at the top of the frame, before input is read
+    void beginFrame()
+    {
+        if (MaxFramesInFlight < 1)
+            MaxFramesInFlight = 1;
+        if (MaxFramesInFlight > FRAME_RING_FRAMES)
+            MaxFramesInFlight = FRAME_RING_FRAMES;
+        double start = glfwGetTime();
+        while (fences.size() >= MaxFramesInFlight)
+            waitOldest();
+        WaitTime = glfwGetTime() - start;
+    }
+
+    // call right after glfwSwapBuffers
+    void endFrame()
+    {
+        fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    }
+
+private:
+    std::deque<GLsync> fences;
+
+    void waitOldest()
+    {
+        GLsync fence = fences.front();
+        fences.pop_front();
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        if (status == GL_WAIT_FAILED)
+            std::cout << "ERROR::FRAME_PACER::FENCE_WAIT_FAILED" << std::endl;
+        glDeleteSync(fence);
+    }
+};
+#endif
@@ -0,0 +1,136 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <iostream>
+
+// Default ring values
+const unsigned int FRAME_RING_FRAMES = 3;
+
+// A buffer split into one region per frame in flight, for data rewritten every frame. With
+// GL 4.4 or ARB_buffer_storage the buffer is persistently and coherently mapped, so writing
+// per-frame data is a plain memcpy into the region of the current frame. A fence placed at
+// the end of each frame guards the region until the GPU has consumed it; with three regions
+// that wait normally never blocks. Without buffer storage, allocations go to a CPU staging
+// copy and commit() uploads them with one glBufferSubData into a region the GPU is not using.
+class FrameRingBuffer
+{
+public:
+    unsigned int Buffer;
+    GLenum Target;
+    unsigned int FrameCount;
+    GLsizeiptr FrameSize;
+    GLintptr Alignment;
+    bool Persistent;
+
+    // constructor allocates frameCount regions of frameSize bytes; needs a current GL context
+    FrameRingBuffer(GLenum target, GLsizeiptr frameSize, unsigned int frameCount = FRAME_RING_FRAMES) : Buffer(0), Target(target), FrameCount(frameCount), FrameSize(frameSize), Alignment(16), Persistent(false), frame(0), head(0), committed(0), mapped(nullptr)
+    {
+        if (Target == GL_UNIFORM_BUFFER)
+        {
+            GLint align = 0;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+            if (align > Alignment)
+                Alignment = align;
+        }
+        FrameSize = (FrameSize + Alignment - 1) / Alignment * Alignment;
+        fences.assign(FrameCount, (GLsync)0);
+
+        glGenBuffers(1, &Buffer);
+        glBindBuffer(Target, Buffer);
+        if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(Target, FrameSize * FrameCount, NULL, flags);
+            mapped = (unsigned char *)glMapBufferRange(Target, 0, FrameSize * FrameCount, flags);
+            Persistent = mapped != nullptr;
+        }
+        if (!Persistent)
+        {
+            glBufferData(Target, FrameSize * FrameCount, NULL, GL_STREAM_DRAW);
+            staging.resize(FrameSize);
+        }
+        glBindBuffer(Target, 0);
+    }
+    ~FrameRingBuffer()
+    {
+        for (unsigned int i = 0; i < FrameCount; i++)
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        if (Persistent)
+        {
+            glBindBuffer(Target, Buffer);
+            glUnmapBuffer(Target);
+            glBindBuffer(Target, 0);
+        }
+        glDeleteBuffers(1, &Buffer);
+    }
+
+    // moves to the next region, waiting until the GPU is done with it
+    void beginFrame()
+    {
+        frame = (frame + 1) % FrameCount;
+        head = 0;
+        committed = 0;
+        waitFrame(frame);
+    }
+
+    // returns memory for 'size' bytes of this frame and their offset in Buffer, or nullptr
+    // when the region is full; fill it before commit()
+    void *allocate(GLsizeiptr size, GLintptr &offset)
+    {
+        GLintptr start = (head + Alignment - 1) / Alignment * Alignment;
+        if (start + size > FrameSize)
+        {
+            std::cout << "ERROR::FRAME_RING::REGION_FULL" << std::endl;
+            return nullptr;
+        }
+        head = start + size;
+        offset = (GLintptr)frame * FrameSize + start;
+        return Persistent ? (void *)(mapped + offset) : (void *)(&staging[0] + start);
+    }
+
+    // makes everything allocated so far visible to the GPU; call before the draws that read it.
+    // The coherent mapping needs nothing, the fallback uploads the new bytes.
+    void commit()
+    {
+        if (!Persistent && head > committed)
+        {
+            glBindBuffer(Target, Buffer);
+            glBufferSubData(Target, (GLintptr)frame * FrameSize + committed, head - committed, &staging[0] + committed);
+            glBindBuffer(Target, 0);
+        }
+        committed = head;
+    }
+
+    // fences the region after the last draw that reads it was submitted
+    void endFrame()
+    {
+        commit();
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    unsigned int frame;
+    GLintptr head;
+    GLintptr committed;
+    unsigned char *mapped;
+    std::vector<unsigned char> staging;
+    std::vector<GLsync> fences;
+
+    void waitFrame(unsigned int index)
+    {
+        if (!fences[index])
+            return;
+        GLenum status = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        if (status == GL_WAIT_FAILED)
+            std::cout << "ERROR::FRAME_RING::FENCE_WAIT_FAILED" << std::endl;
+        glDeleteSync(fences[index]);
+        fences[index] = 0;
+    }
+};
+#endif
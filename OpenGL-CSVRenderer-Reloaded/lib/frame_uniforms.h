@@ -0,0 +1,87 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "frame_ring.h"
+
+#include <cstring>
+
+// Uniform block shared by every program that draws the scene; must match the
+// "FrameData" block declared in the shaders
+const char *const FRAME_UNIFORM_BLOCK = "FrameData";
+const unsigned int FRAME_UNIFORM_BINDING = 0;
+
+// std140 layout of the FrameData block. vec3 members are 16-byte aligned, so each is
+// followed by either padding or the scalar that std140 packs into its fourth slot.
+struct FrameData
+{
+    glm::mat4 Projection;       // offset   0
+    glm::mat4 View;             // offset  64
+    glm::vec3 ViewPos;          // offset 128
+    float     pad0;
+    glm::vec3 LightPos;         // offset 144
+    float     pad1;
+    glm::vec3 LightColor;       // offset 160
+    float     SpecularStrength; // offset 172
+};
+static_assert(sizeof(FrameData) == 176, "FrameData must match the std140 layout of the shader block");
+
+// Uniform block with the transform of one non-instanced draw; must match the "ObjectData"
+// block declared in the shaders
+const char *const OBJECT_UNIFORM_BLOCK = "ObjectData";
+const unsigned int OBJECT_UNIFORM_BINDING = 1;
+
+// std140 layout of the ObjectData block; each column of a mat3 takes a whole vec4
+struct ObjectData
+{
+    glm::mat4 Model;            // offset   0
+    glm::vec4 NormalMatrix[3];  // offset  64
+};
+static_assert(sizeof(ObjectData) == 112, "ObjectData must match the std140 layout of the shader block");
+
+// copies one draw's transform into the current frame of 'ring'; returns its offset in
+// ring.Buffer, or -1 if the region is full. Call the ring's commit() before drawing.
+inline GLintptr writeObjectData(FrameRingBuffer &ring, const glm::mat4 &model, const glm::mat3 &normalMatrix)
+{
+    GLintptr offset = 0;
+    ObjectData *dst = (ObjectData *)ring.allocate(sizeof(ObjectData), offset);
+    if (dst == nullptr)
+        return -1;
+    dst->Model = model;
+    for (int c = 0; c < 3; c++)
+        dst->NormalMatrix[c] = glm::vec4(normalMatrix[c], 0.0f);
+    return offset;
+}
+
+// Writes the per-frame uniforms into the region of the current frame of a FrameRingBuffer
+// and binds that range to FRAME_UNIFORM_BINDING, so they are uploaded once per frame
+// instead of once per program, without waiting for the GPU to release last frame's copy
+class FrameUniformBuffer
+{
+public:
+    FrameData Data;
+
+    // the ring must target GL_UNIFORM_BUFFER and outlive this object
+    FrameUniformBuffer(FrameRingBuffer &ring) : Data(), ring(ring)
+    {
+    }
+
+    // pushes the whole block to the GPU; call once per frame after filling Data and after
+    // the ring's beginFrame()
+    void upload()
+    {
+        GLintptr offset = 0;
+        void *dst = ring.allocate(sizeof(FrameData), offset);
+        if (dst == nullptr)
+            return;
+        std::memcpy(dst, &Data, sizeof(FrameData));
+        ring.commit();
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, ring.Buffer, offset, sizeof(FrameData));
+    }
+
+private:
+    FrameRingBuffer &ring;
+};
+#endif
@@ -0,0 +1,82 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+
+#include <cmath>
+
+// The six planes of a view frustum in world space, extracted from projection * view
+// (Gribb & Hartmann). Each plane is (normal, distance) with the normal pointing inwards, so
+// dot(normal, p) + distance < 0 means p lies outside. The tests are conservative: a bound
+// that straddles two planes outside a corner still counts as visible.
+class Frustum
+{
+public:
+    enum
+    {
+        PLANE_LEFT,
+        PLANE_RIGHT,
+        PLANE_BOTTOM,
+        PLANE_TOP,
+        PLANE_NEAR,
+        PLANE_FAR,
+        PLANE_COUNT
+    };
+    glm::vec4 Planes[PLANE_COUNT];
+
+    Frustum()
+    {
+        for (int i = 0; i < PLANE_COUNT; i++)
+            Planes[i] = glm::vec4(0.0f);
+    }
+    Frustum(const glm::mat4 &viewProjection)
+    {
+        update(viewProjection);
+    }
+
+    void update(const glm::mat4 &m)
+    {
+        // rows of the matrix; glm stores columns
+        glm::vec4 row[4];
+        for (int r = 0; r < 4; r++)
+            row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+        Planes[PLANE_LEFT] = row[3] + row[0];
+        Planes[PLANE_RIGHT] = row[3] - row[0];
+        Planes[PLANE_BOTTOM] = row[3] + row[1];
+        Planes[PLANE_TOP] = row[3] - row[1];
+        Planes[PLANE_NEAR] = row[3] + row[2];
+        Planes[PLANE_FAR] = row[3] - row[2];
+        // unit normals, so sphere radii can be compared with the plane distances
+        for (int i = 0; i < PLANE_COUNT; i++)
+        {
+            float length = std::sqrt(Planes[i].x * Planes[i].x + Planes[i].y * Planes[i].y + Planes[i].z * Planes[i].z);
+            if (length > 0.0f)
+                Planes[i] /= length;
+        }
+    }
+
+    bool intersects(const BoundingSphere &sphere) const
+    {
+        for (int i = 0; i < PLANE_COUNT; i++)
+            if (glm::dot(glm::vec3(Planes[i]), sphere.Center) + Planes[i].w < -sphere.Radius)
+                return false;
+        return true;
+    }
+
+    // tests the corner furthest along each plane normal
+    bool intersects(const AABB &box) const
+    {
+        for (int i = 0; i < PLANE_COUNT; i++)
+        {
+            glm::vec3 p(Planes[i].x >= 0.0f ? box.Max.x : box.Min.x,
+                        Planes[i].y >= 0.0f ? box.Max.y : box.Min.y,
+                        Planes[i].z >= 0.0f ? box.Max.z : box.Min.z);
+            if (glm::dot(glm::vec3(Planes[i]), p) + Planes[i].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,212 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// texture units tracked by the cache; binds to higher units are always issued
+const unsigned int STATE_TEXTURE_UNITS = 16;
+
+// Mirrors the bits of GL state the renderer changes per draw (program, VAO, 2D textures,
+// capabilities, blend and depth functions, write masks) and drops calls that would set a value that is
+// already current. Everything starts out unknown, so the first call of each kind is always
+// issued. All state changes on the render context must go through the cache, otherwise it
+// no longer matches the driver; objects that are deleted must be forgotten.
+class GLStateCache
+{
+public:
+    // calls that reached GL and calls that were dropped as redundant
+    struct Stats
+    {
+        unsigned long long Issued;
+        unsigned long long Filtered;
+    };
+    Stats Counters;
+
+    GLStateCache()
+    {
+        Counters.Issued = 0;
+        Counters.Filtered = 0;
+        invalidate();
+    }
+
+    // forgets everything; use after code outside the cache touched GL state
+    void invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int i = 0; i < STATE_TEXTURE_UNITS; i++)
+            textures[i] = UNKNOWN;
+        capabilities.clear();
+        blendSrc = blendDst = UNKNOWN;
+        depthFunction = UNKNOWN;
+        depthWrite = UNKNOWN;
+        colorWrite = UNKNOWN;
+    }
+
+    void useProgram(unsigned int id)
+    {
+        if (filter(program, id))
+            return;
+        glUseProgram(id);
+    }
+    void bindVertexArray(unsigned int id)
+    {
+        if (filter(vertexArray, id))
+            return;
+        glBindVertexArray(id);
+    }
+    // binds a GL_TEXTURE_2D to the given unit, switching the active unit only if needed
+    void bindTexture(unsigned int id, unsigned int unit = 0)
+    {
+        if (unit >= STATE_TEXTURE_UNITS)
+        {
+            activeTexture(unit);
+            count(false);
+            glBindTexture(GL_TEXTURE_2D, id);
+            return;
+        }
+        if (textures[unit] == id)
+        {
+            count(true);
+            return;
+        }
+        activeTexture(unit);
+        textures[unit] = id;
+        count(false);
+        glBindTexture(GL_TEXTURE_2D, id);
+    }
+    void activeTexture(unsigned int unit)
+    {
+        if (filter(activeUnit, unit))
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    void enable(GLenum cap)
+    {
+        setCapability(cap, true);
+    }
+    void disable(GLenum cap)
+    {
+        setCapability(cap, false);
+    }
+    void blendFunc(GLenum src, GLenum dst)
+    {
+        if (blendSrc == src && blendDst == dst)
+        {
+            count(true);
+            return;
+        }
+        blendSrc = src;
+        blendDst = dst;
+        count(false);
+        glBlendFunc(src, dst);
+    }
+    void depthFunc(GLenum func)
+    {
+        if (filter(depthFunction, func))
+            return;
+        glDepthFunc(func);
+    }
+    void depthMask(bool write)
+    {
+        if (filter(depthWrite, write ? 1u : 0u))
+            return;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+    // all four channels at once
+    void colorMask(bool write)
+    {
+        if (filter(colorWrite, write ? 1u : 0u))
+            return;
+        GLboolean w = write ? GL_TRUE : GL_FALSE;
+        glColorMask(w, w, w, w);
+    }
+
+    // call before deleting these objects; GL may hand the same name out again afterwards
+    void forgetProgram(unsigned int id)
+    {
+        if (program == id)
+            program = UNKNOWN;
+    }
+    void forgetVertexArray(unsigned int id)
+    {
+        // deleting a bound VAO reverts the binding to 0
+        if (vertexArray == id)
+            vertexArray = 0;
+    }
+    void forgetTexture(unsigned int id)
+    {
+        // deleting a bound texture reverts the binding of that unit to 0
+        for (unsigned int i = 0; i < STATE_TEXTURE_UNITS; i++)
+            if (textures[i] == id)
+                textures[i] = 0;
+    }
+
+    void resetCounters()
+    {
+        Counters.Issued = 0;
+        Counters.Filtered = 0;
+    }
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int textures[STATE_TEXTURE_UNITS];
+    std::vector<std::pair<GLenum, bool> > capabilities;
+    unsigned int blendSrc, blendDst;
+    unsigned int depthFunction;
+    unsigned int depthWrite;
+    unsigned int colorWrite;
+
+    void count(bool filtered)
+    {
+        if (filtered)
+            Counters.Filtered++;
+        else
+            Counters.Issued++;
+    }
+    // true if 'current' already holds 'value'; otherwise records it and returns false
+    bool filter(unsigned int &current, unsigned int value)
+    {
+        bool same = current == value;
+        current = value;
+        count(same);
+        return same;
+    }
+    void setCapability(GLenum cap, bool on)
+    {
+        for (size_t i = 0; i < capabilities.size(); i++)
+        {
+            if (capabilities[i].first != cap)
+                continue;
+            if (capabilities[i].second == on)
+            {
+                count(true);
+                return;
+            }
+            capabilities[i].second = on;
+            count(false);
+            on ? glEnable(cap) : glDisable(cap);
+            return;
+        }
+        capabilities.push_back(std::make_pair(cap, on));
+        count(false);
+        on ? glEnable(cap) : glDisable(cap);
+    }
+};
+
+// the cache for the render context; only use it on the thread that owns that context
+inline GLStateCache &glState()
+{
+    static GLStateCache cache;
+    return cache;
+}
+#endif
@@ -0,0 +1,65 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <GL/glew.h>
+
+// Default number of queries in the ring; must exceed the frames the GPU can lag behind
+const unsigned int GPU_TIMER_QUERIES = 4;
+
+// Measures the GPU time of a span of commands with GL_TIME_ELAPSED queries (core in 3.3).
+// Results are read from a ring of queries only once they are available, a few frames after
+// they were issued, so measuring never stalls the pipeline.
+class GpuTimer
+{
+public:
+    // milliseconds of the most recent span whose result arrived, negative until the first one
+    double LastTime;
+
+    GpuTimer() : LastTime(-1.0), current(0)
+    {
+        glGenQueries(GPU_TIMER_QUERIES, queries);
+        for (unsigned int i = 0; i < GPU_TIMER_QUERIES; i++)
+            issued[i] = false;
+    }
+    ~GpuTimer()
+    {
+        glDeleteQueries(GPU_TIMER_QUERIES, queries);
+    }
+
+    void begin()
+    {
+        collect();
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        issued[current] = true;
+        current = (current + 1) % GPU_TIMER_QUERIES;
+    }
+
+private:
+    unsigned int queries[GPU_TIMER_QUERIES];
+    bool issued[GPU_TIMER_QUERIES];
+    unsigned int current;
+
+    // reads every finished query, oldest first, so LastTime ends up the newest result
+    void collect()
+    {
+        for (unsigned int n = 0; n < GPU_TIMER_QUERIES; n++)
+        {
+            unsigned int i = (current + n) % GPU_TIMER_QUERIES;
+            if (!issued[i])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+            LastTime = elapsed / 1.0e6;
+            issued[i] = false;
+        }
+    }
+};
+#endif
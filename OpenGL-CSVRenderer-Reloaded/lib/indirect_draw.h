@@ -0,0 +1,129 @@
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstddef>
+
+// layout glMultiDrawArraysIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawArraysIndirectCommand
+{
+    GLuint Count;
+    GLuint InstanceCount;
+    GLuint First;
+    GLuint BaseInstance;
+};
+
+// A draw list kept in a GL_DRAW_INDIRECT_BUFFER so a whole range of it is submitted with one
+// glMultiDrawArraysIndirect call. A CPU copy of the commands is compared on every write and
+// only the commands that actually changed are re-uploaded. A hidden command keeps its slot
+// with InstanceCount = 0, so toggling visibility never shifts the rest of the list.
+// Without GL 4.3 / ARB_multi_draw_indirect the same list is drawn with a loop of
+// glDrawArraysInstanced calls; BaseInstance is ignored there.
+class IndirectDrawBuffer
+{
+public:
+    unsigned int Buffer;
+    bool Indirect;
+    std::vector<DrawArraysIndirectCommand> Commands;
+
+    // constructor; needs a current GL context
+    IndirectDrawBuffer() : Buffer(0), capacity(0)
+    {
+        Indirect = GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+        if (Indirect)
+            glGenBuffers(1, &Buffer);
+    }
+    ~IndirectDrawBuffer()
+    {
+        if (Buffer)
+            glDeleteBuffers(1, &Buffer);
+    }
+
+    // sets the number of commands; new commands draw nothing until set
+    void resize(size_t count)
+    {
+        DrawArraysIndirectCommand empty = { 0, 0, 0, 0 };
+        Commands.resize(count, empty);
+        dirty.resize(count, true);
+    }
+
+    // writes command 'index'; it is only marked for upload if it differs from what is there
+    void setCommand(size_t index, GLuint first, GLuint count, GLuint instanceCount = 1, GLuint baseInstance = 0)
+    {
+        DrawArraysIndirectCommand &c = Commands[index];
+        if (c.First == first && c.Count == count && c.InstanceCount == instanceCount && c.BaseInstance == baseInstance)
+            return;
+        c.First = first;
+        c.Count = count;
+        c.InstanceCount = instanceCount;
+        c.BaseInstance = baseInstance;
+        dirty[index] = true;
+    }
+    // hides or shows a command with the given number of instances, keeping its slot
+    void setVisible(size_t index, bool visible, GLuint instanceCount = 1)
+    {
+        DrawArraysIndirectCommand &c = Commands[index];
+        setCommand(index, c.First, c.Count, visible ? instanceCount : 0, c.BaseInstance);
+    }
+
+    // pushes every run of changed commands to the GPU; call after the writes of a frame
+    void upload()
+    {
+        if (!Indirect)
+        {
+            dirty.assign(dirty.size(), false);
+            return;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, Buffer);
+        if (Commands.size() > capacity)
+        {
+            // grow, leaving headroom so a few more commands don't reallocate again
+            capacity = Commands.size() + Commands.size() / 2;
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawArraysIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+            dirty.assign(dirty.size(), true);
+        }
+        for (size_t i = 0; i < Commands.size();)
+        {
+            if (!dirty[i])
+            {
+                i++;
+                continue;
+            }
+            size_t end = i;
+            while (end < Commands.size() && dirty[end])
+                dirty[end++] = false;
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, i * sizeof(DrawArraysIndirectCommand), (end - i) * sizeof(DrawArraysIndirectCommand), &Commands[i]);
+            i = end;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // draws commands [first, first + count); the VAO must be bound and upload() called
+    void draw(size_t first, size_t count)
+    {
+        if (count == 0)
+            return;
+        if (Indirect)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, Buffer);
+            glMultiDrawArraysIndirect(GL_TRIANGLES, (void *)(first * sizeof(DrawArraysIndirectCommand)), (GLsizei)count, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            return;
+        }
+        for (size_t i = first; i < first + count; i++)
+        {
+            const DrawArraysIndirectCommand &c = Commands[i];
+            if (c.InstanceCount == 1)
+                glDrawArrays(GL_TRIANGLES, c.First, c.Count);
+            else if (c.InstanceCount > 1)
+                glDrawArraysInstanced(GL_TRIANGLES, c.First, c.Count, c.InstanceCount);
+        }
+    }
+
+private:
+    size_t capacity;
+    std::vector<bool> dirty;
+};
+#endif
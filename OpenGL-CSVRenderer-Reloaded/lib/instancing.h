@@ -0,0 +1,137 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "gl_state.h"
+#include "static_mesh.h"
+#include "normal_matrix.h"
+
+#include <vector>
+#include <cstddef>
+
+// per-instance vertex attributes, read by the INSTANCED shader variant; a mat4 takes four
+// consecutive locations and a mat3 three
+const unsigned int INSTANCE_ATTRIB_MODEL  = 4;  // 4..7
+const unsigned int INSTANCE_ATTRIB_NORMAL = 8;  // 8..10
+const unsigned int INSTANCE_ATTRIB_TINT   = 11;
+
+// vertex layout of the instance buffer
+struct InstanceData
+{
+    glm::mat4 Model;
+    glm::mat3 NormalMatrix;
+    glm::vec3 Tint;
+};
+
+// One mesh of a StaticMeshBuffer placed many times. The mesh must have been added in object
+// space (identity transform); each placement only costs an InstanceData in a second vertex
+// buffer with attribute divisor 1, and all of them are drawn with one glDrawArraysInstanced.
+// DepthVAO pairs the position-only stream with the same instance buffer for the depth pre-pass.
+class InstancedMesh
+{
+public:
+    unsigned int VAO;
+    unsigned int DepthVAO;
+    unsigned int InstanceVBO;
+    GLint First;
+    GLsizei Count;
+    std::vector<glm::mat4> Transforms;
+    std::vector<glm::vec3> Tints;
+
+    // constructor builds a VAO over the mesh's vertices; 'meshes' must be finished
+    InstancedMesh(const StaticMeshBuffer &meshes, unsigned int mesh) : VAO(0), DepthVAO(0), InstanceVBO(0), First(meshes.Meshes[mesh].First), Count(meshes.Meshes[mesh].Count), uploaded(0)
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &InstanceVBO);
+        glState().bindVertexArray(VAO);
+
+        // per-vertex attributes, shared with the static mesh buffer
+        GLsizei stride = MESH_VERTEX_FLOATS * sizeof(float);
+        glBindBuffer(GL_ARRAY_BUFFER, meshes.VBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void *)(9 * sizeof(float)));
+        glEnableVertexAttribArray(3);
+
+        // per-instance attributes
+        glBindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+        stride = sizeof(InstanceData);
+        for (unsigned int c = 0; c < 4; c++)
+            instanceAttrib(INSTANCE_ATTRIB_MODEL + c, 4, stride, offsetof(InstanceData, Model) + c * sizeof(glm::vec4));
+        for (unsigned int c = 0; c < 3; c++)
+            instanceAttrib(INSTANCE_ATTRIB_NORMAL + c, 3, stride, offsetof(InstanceData, NormalMatrix) + c * sizeof(glm::vec3));
+        instanceAttrib(INSTANCE_ATTRIB_TINT, 3, stride, offsetof(InstanceData, Tint));
+
+        // depth pre-pass: positions and model matrices only
+        glGenVertexArrays(1, &DepthVAO);
+        glState().bindVertexArray(DepthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, meshes.PositionVBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+        for (unsigned int c = 0; c < 4; c++)
+            instanceAttrib(INSTANCE_ATTRIB_MODEL + c, 4, stride, offsetof(InstanceData, Model) + c * sizeof(glm::vec4));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    ~InstancedMesh()
+    {
+        glState().forgetVertexArray(VAO);
+        glDeleteVertexArrays(1, &VAO);
+        glState().forgetVertexArray(DepthVAO);
+        glDeleteVertexArrays(1, &DepthVAO);
+        glDeleteBuffers(1, &InstanceVBO);
+    }
+
+    // adds a placement; takes effect on the next upload()
+    void add(const glm::mat4 &model, const glm::vec3 &tint = glm::vec3(1.0f))
+    {
+        Transforms.push_back(model);
+        Tints.push_back(tint);
+    }
+
+    // computes the normal matrices and pushes all placements to the instance buffer
+    void upload()
+    {
+        size_t count = Transforms.size();
+        std::vector<glm::mat3> normals(count);
+        computeNormalMatrices(Transforms.data(), normals.data(), count);
+        std::vector<InstanceData> data(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            data[i].Model = Transforms[i];
+            data[i].NormalMatrix = normals[i];
+            data[i].Tint = Tints[i];
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(InstanceData), data.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        uploaded = count;
+    }
+
+    // draws every uploaded placement with an INSTANCED program in use; 'depthOnly' uses the
+    // position-only stream for the depth pre-pass
+    void draw(bool depthOnly = false)
+    {
+        if (uploaded == 0)
+            return;
+        glState().bindVertexArray(depthOnly ? DepthVAO : VAO);
+        glDrawArraysInstanced(GL_TRIANGLES, First, Count, (GLsizei)uploaded);
+    }
+
+private:
+    size_t uploaded;
+
+    static void instanceAttrib(unsigned int location, int size, GLsizei stride, size_t offset)
+    {
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, stride, (void *)offset);
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+};
+#endif
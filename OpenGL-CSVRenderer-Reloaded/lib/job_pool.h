@@ -0,0 +1,119 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <cstddef>
+
+// Persistent worker threads for data-parallel CPU work within a frame. parallelFor() cuts
+// a range into chunks that the workers and the calling thread take in turns, and returns
+// once all chunks are done. The jobs must not call GL: only the thread that owns the
+// context may do that.
+class JobPool
+{
+public:
+    unsigned int Workers;
+
+    // 'workers' threads in addition to the calling one; by default one per remaining core
+    JobPool(unsigned int workers = defaultWorkers()) : Workers(workers), stopping(false), generation(0), count(0), grain(1), next(0), busy(0)
+    {
+        for (unsigned int i = 0; i < Workers; i++)
+            threads.push_back(std::thread(&JobPool::workerLoop, this));
+    }
+    ~JobPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+    }
+
+    // calls job(begin, end) on disjoint chunks of [0, total) of at most 'chunk' items
+    void parallelFor(size_t total, size_t chunk, const std::function<void(size_t, size_t)> &job)
+    {
+        if (total == 0)
+            return;
+        if (Workers == 0 || total <= chunk)
+        {
+            job(0, total);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = job;
+            count = total;
+            grain = chunk > 0 ? chunk : 1;
+            next = 0;
+            busy = Workers;
+            generation++;
+        }
+        wake.notify_all();
+        run();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+        current = nullptr;
+    }
+
+    static unsigned int defaultWorkers()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping;
+    unsigned long long generation;
+
+    // the job in flight
+    std::function<void(size_t, size_t)> current;
+    size_t count;
+    size_t grain;
+    std::atomic<size_t> next;
+    unsigned int busy;      // workers that have not finished the current job
+
+    // takes chunks until the range is exhausted
+    void run()
+    {
+        for (;;)
+        {
+            size_t begin = next.fetch_add(grain);
+            if (begin >= count)
+                return;
+            size_t end = begin + grain < count ? begin + grain : count;
+            current(begin, end);
+        }
+    }
+
+    void workerLoop()
+    {
+        unsigned long long seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            run();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy--;
+            }
+            done.notify_one();
+        }
+    }
+};
+#endif
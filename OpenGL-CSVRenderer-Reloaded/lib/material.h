@@ -0,0 +1,37 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+// How a material's fragments combine with the framebuffer; also the order of the passes.
+// Opaque and alpha-tested geometry is drawn with blending off and writes depth; only
+// blended geometry pays for read-modify-write blending and is sorted back to front.
+enum MaterialClass
+{
+    MATERIAL_OPAQUE,
+    MATERIAL_ALPHA_TESTED,   // texels are either fully transparent or fully opaque; discarded in the shader
+    MATERIAL_BLENDED
+};
+
+// share of partially transparent texels up to which a texture is still treated as a cut-out;
+// the few soft texels along its edges then get the alpha test instead of blending
+const float MATERIAL_BLEND_FRACTION = 0.01f;
+
+// classifies RGBA8 pixels by their alpha channel
+inline MaterialClass classifyAlpha(const unsigned char *rgba, int width, int height)
+{
+    unsigned long long texels = (unsigned long long)width * height;
+    unsigned long long transparent = 0, partial = 0;
+    for (unsigned long long i = 0; i < texels; i++)
+    {
+        unsigned char a = rgba[i * 4 + 3];
+        if (a == 0)
+            transparent++;
+        else if (a != 255)
+            partial++;
+    }
+    if (transparent == 0 && partial == 0)
+        return MATERIAL_OPAQUE;
+    if (partial <= texels * MATERIAL_BLEND_FRACTION)
+        return MATERIAL_ALPHA_TESTED;
+    return MATERIAL_BLENDED;
+}
+#endif
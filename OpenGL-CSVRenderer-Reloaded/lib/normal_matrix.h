@@ -0,0 +1,84 @@
+#ifndef NORMAL_MATRIX_H
+#define NORMAL_MATRIX_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define NORMAL_MATRIX_SSE
+#include <xmmintrin.h>
+#endif
+
+// The normal matrix is transpose(inverse(mat3(model))). For a 3x3 matrix with columns
+// a, b, c that equals the cofactor matrix over the determinant:
+//     [b x c, c x a, a x b] / dot(a, b x c)
+// which needs no general inverse and maps well onto SIMD.
+
+// normal matrix of a single model matrix
+inline glm::mat3 normalMatrix(const glm::mat4 &model)
+{
+    glm::vec3 a(model[0]), b(model[1]), c(model[2]);
+    glm::vec3 bc = glm::cross(b, c);
+    float invDet = 1.0f / glm::dot(a, bc);
+    return glm::mat3(bc * invDet, glm::cross(c, a) * invDet, glm::cross(a, b) * invDet);
+}
+
+// normal matrices for 'count' model matrices; with SSE four matrices are handled per step
+inline void computeNormalMatrices(const glm::mat4 *models, glm::mat3 *normals, size_t count)
+{
+    size_t i = 0;
+#ifdef NORMAL_MATRIX_SSE
+    for (; i + 4 <= count; i += 4)
+    {
+        const float *m0 = &models[i + 0][0][0];
+        const float *m1 = &models[i + 1][0][0];
+        const float *m2 = &models[i + 2][0][0];
+        const float *m3 = &models[i + 3][0][0];
+
+        // transpose column k of the four matrices so each register holds one component of four matrices
+        __m128 ax = _mm_loadu_ps(m0), ay = _mm_loadu_ps(m1), az = _mm_loadu_ps(m2), aw = _mm_loadu_ps(m3);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+        __m128 bx = _mm_loadu_ps(m0 + 4), by = _mm_loadu_ps(m1 + 4), bz = _mm_loadu_ps(m2 + 4), bw = _mm_loadu_ps(m3 + 4);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+        __m128 cx = _mm_loadu_ps(m0 + 8), cy = _mm_loadu_ps(m1 + 8), cz = _mm_loadu_ps(m2 + 8), cw = _mm_loadu_ps(m3 + 8);
+        _MM_TRANSPOSE4_PS(cx, cy, cz, cw);
+
+        // b x c, c x a, a x b
+        __m128 r0x = _mm_sub_ps(_mm_mul_ps(by, cz), _mm_mul_ps(bz, cy));
+        __m128 r0y = _mm_sub_ps(_mm_mul_ps(bz, cx), _mm_mul_ps(bx, cz));
+        __m128 r0z = _mm_sub_ps(_mm_mul_ps(bx, cy), _mm_mul_ps(by, cx));
+        __m128 r1x = _mm_sub_ps(_mm_mul_ps(cy, az), _mm_mul_ps(cz, ay));
+        __m128 r1y = _mm_sub_ps(_mm_mul_ps(cz, ax), _mm_mul_ps(cx, az));
+        __m128 r1z = _mm_sub_ps(_mm_mul_ps(cx, ay), _mm_mul_ps(cy, ax));
+        __m128 r2x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+        __m128 r2y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+        __m128 r2z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, r0x), _mm_mul_ps(ay, r0y)), _mm_mul_ps(az, r0z));
+        __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+        r0x = _mm_mul_ps(r0x, invDet); r0y = _mm_mul_ps(r0y, invDet); r0z = _mm_mul_ps(r0z, invDet);
+        r1x = _mm_mul_ps(r1x, invDet); r1y = _mm_mul_ps(r1y, invDet); r1z = _mm_mul_ps(r1z, invDet);
+        r2x = _mm_mul_ps(r2x, invDet); r2y = _mm_mul_ps(r2y, invDet); r2z = _mm_mul_ps(r2z, invDet);
+
+        // back to one matrix per register set; mat3 columns are 3 floats, so store 3 at a time
+        __m128 zero = _mm_setzero_ps(), t0 = zero, t1 = zero, t2 = zero;
+        float col[3][4][4];
+        _MM_TRANSPOSE4_PS(r0x, r0y, r0z, t0);
+        _MM_TRANSPOSE4_PS(r1x, r1y, r1z, t1);
+        _MM_TRANSPOSE4_PS(r2x, r2y, r2z, t2);
+        _mm_storeu_ps(col[0][0], r0x); _mm_storeu_ps(col[0][1], r0y); _mm_storeu_ps(col[0][2], r0z); _mm_storeu_ps(col[0][3], t0);
+        _mm_storeu_ps(col[1][0], r1x); _mm_storeu_ps(col[1][1], r1y); _mm_storeu_ps(col[1][2], r1z); _mm_storeu_ps(col[1][3], t1);
+        _mm_storeu_ps(col[2][0], r2x); _mm_storeu_ps(col[2][1], r2y); _mm_storeu_ps(col[2][2], r2z); _mm_storeu_ps(col[2][3], t2);
+        for (int m = 0; m < 4; m++)
+        {
+            glm::mat3 &n = normals[i + m];
+            for (int c = 0; c < 3; c++)
+                n[c] = glm::vec3(col[c][m][0], col[c][m][1], col[c][m][2]);
+        }
+    }
+#endif
+    for (; i < count; i++)
+        normals[i] = normalMatrix(models[i]);
+}
+#endif
@@ -0,0 +1,91 @@
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+// Default governor values
+const double QUALITY_TARGET_MS   = 1000.0 / 60.0;
+const double QUALITY_DROP_RATIO  = 1.05;   // step down when slower than target by this much...
+const double QUALITY_RAISE_RATIO = 0.70;   // ...step up only when this much faster
+const int    QUALITY_DROP_FRAMES  = 15;    // frames a condition must hold before acting
+const int    QUALITY_RAISE_FRAMES = 90;
+
+// what one quality level changes
+struct QualityLevel
+{
+    float ResolutionScale;      // of the window size the scene is rendered at
+    float LodBias;              // multiplies the Phong/Gouraud screen size threshold
+    bool ForceGouraud;          // per-vertex lighting for everything
+};
+
+// from full quality down to the cheapest setting
+const QualityLevel QUALITY_LEVELS[] =
+{
+    { 1.00f, 1.0f, false },
+    { 1.00f, 2.0f, false },
+    { 0.85f, 4.0f, false },
+    { 0.70f, 8.0f, false },
+    { 0.60f, 8.0f, true  },
+    { 0.50f, 8.0f, true  }
+};
+const int QUALITY_LEVEL_COUNT = sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]);
+
+// Holds a target frame time by stepping through QUALITY_LEVELS. The frame cost is the larger
+// of the CPU and GPU times, since whichever is slower sets the frame rate; it is smoothed with
+// an exponential moving average. Dropping reacts within a fraction of a second, raising needs
+// a long stretch of headroom, and the gap between the two ratios keeps the governor from
+// oscillating between neighbouring levels.
+class QualityGovernor
+{
+public:
+    double TargetTime;      // milliseconds
+    double FrameTime;       // smoothed cost, milliseconds
+    int Level;              // index in QUALITY_LEVELS
+    bool Enabled;
+
+    QualityGovernor(double targetTime = QUALITY_TARGET_MS) : TargetTime(targetTime), FrameTime(0.0), Level(0), Enabled(true), slowFrames(0), fastFrames(0)
+    {
+    }
+
+    const QualityLevel &current() const
+    {
+        return QUALITY_LEVELS[Enabled ? Level : 0];
+    }
+
+    // feeds one frame's measurements; returns true if the level changed. A negative GPU
+    // time means no measurement has arrived yet.
+    bool update(double cpuTime, double gpuTime)
+    {
+        double cost = gpuTime > cpuTime ? gpuTime : cpuTime;
+        FrameTime = FrameTime == 0.0 ? cost : FrameTime * 0.9 + cost * 0.1;
+        if (!Enabled)
+            return false;
+
+        slowFrames = FrameTime > TargetTime * QUALITY_DROP_RATIO ? slowFrames + 1 : 0;
+        fastFrames = FrameTime < TargetTime * QUALITY_RAISE_RATIO ? fastFrames + 1 : 0;
+        if (slowFrames >= QUALITY_DROP_FRAMES && Level + 1 < QUALITY_LEVEL_COUNT)
+        {
+            Level++;
+            reset();
+            return true;
+        }
+        if (fastFrames >= QUALITY_RAISE_FRAMES && Level > 0)
+        {
+            Level--;
+            reset();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    int slowFrames;
+    int fastFrames;
+
+    // the smoothed time still reflects the old level, so judge the new one from scratch
+    void reset()
+    {
+        slowFrames = 0;
+        fastFrames = 0;
+        FrameTime = 0.0;
+    }
+};
+#endif
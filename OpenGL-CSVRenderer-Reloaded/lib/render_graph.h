@@ -0,0 +1,560 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "gl_state.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <iostream>
+
+// handle of the window's default framebuffer, present in every graph
+const int RG_BACKBUFFER = 0;
+// frames a pooled texture or framebuffer may go unused before it is released
+const unsigned long long RG_POOL_FRAMES = 120;
+
+// what a transient texture looks like; resources with equal descriptions can share memory
+struct RenderTextureDesc
+{
+    int Width;
+    int Height;
+    GLenum Format;      // sized internal format, e.g. GL_RGBA8 or GL_DEPTH24_STENCIL8
+};
+
+// A frame described as passes that declare the textures they read and write, instead of
+// hand-managed framebuffers. The graph is rebuilt every frame with reset(), createTexture(),
+// addPass(), read() and write(); compile() then
+//   - orders the passes: a reader runs after every writer of what it reads, and writers of
+//     the same resource run in declaration order, each drawing over the previous contents;
+//   - culls passes whose output never reaches the backbuffer;
+//   - gives every transient texture a GL texture from a pool, reusing one whose previous
+//     owner is no longer needed by a later pass, so textures with disjoint lifetimes alias;
+//   - builds a framebuffer per pass from the textures it writes.
+// execute() binds each live pass's framebuffer and viewport, clears every texture on its
+// first write (an aliased texture holds another resource's data before that) and runs the
+// pass. Textures and framebuffers persist across frames and are released once unused for
+// RG_POOL_FRAMES frames, so a steady graph allocates nothing after its first frame.
+class RenderGraph
+{
+public:
+    glm::vec4 ClearColor;
+    // transient resources of the last compile(), and the textures that backed them
+    unsigned int Transients, Textures;
+
+    RenderGraph() : ClearColor(0.0f, 0.0f, 0.0f, 1.0f), Transients(0), Textures(0), screenWidth(0), screenHeight(0), frame(0)
+    {
+    }
+    ~RenderGraph()
+    {
+        for (size_t i = 0; i < framebuffers.size(); i++)
+            glDeleteFramebuffers(1, &framebuffers[i].FBO);
+        for (size_t i = 0; i < pool.size(); i++)
+        {
+            glState().forgetTexture(pool[i].Texture);
+            glDeleteTextures(1, &pool[i].Texture);
+        }
+    }
+
+    // starts describing a new frame drawn to a window of the given framebuffer size
+    void reset(int width, int height)
+    {
+        screenWidth = width;
+        screenHeight = height;
+        passes.clear();
+        resources.clear();
+        order.clear();
+        ResourceNode backbuffer;
+        backbuffer.Name = "backbuffer";
+        backbuffer.Desc.Width = width;
+        backbuffer.Desc.Height = height;
+        backbuffer.Desc.Format = GL_NONE;
+        backbuffer.Imported = true;
+        resources.push_back(backbuffer);
+    }
+
+    // declares a texture that only lives within this frame
+    int createTexture(const std::string &name, int width, int height, GLenum format)
+    {
+        ResourceNode resource;
+        resource.Name = name;
+        resource.Desc.Width = width;
+        resource.Desc.Height = height;
+        resource.Desc.Format = format;
+        resource.Imported = false;
+        resources.push_back(resource);
+        return (int)resources.size() - 1;
+    }
+
+    // declares a pass; 'execute' runs on the context thread with the pass's targets bound
+    int addPass(const std::string &name, const std::function<void()> &execute)
+    {
+        PassNode pass;
+        pass.Name = name;
+        pass.Execute = execute;
+        pass.Live = false;
+        pass.FBO = 0;
+        passes.push_back(pass);
+        return (int)passes.size() - 1;
+    }
+
+    // the pass samples or blits from 'resource'
+    void read(int pass, int resource)
+    {
+        addUnique(passes[pass].Reads, resource);
+    }
+    // the pass renders into 'resource'; depth formats attach as depth, others as colors in
+    // the order they are declared
+    void write(int pass, int resource)
+    {
+        addUnique(passes[pass].Writes, resource);
+    }
+
+    // orders, culls and allocates; false, with nothing to execute, if the graph is invalid
+    bool compile()
+    {
+        frame++;
+        order.clear();
+        if (!sortPasses())
+            return false;
+        cullPasses();
+        releaseUnused();
+        allocateTextures();
+        for (size_t i = 0; i < order.size(); i++)
+            if (!buildFramebuffer(passes[order[i]]))
+            {
+                order.clear();
+                return false;
+            }
+        return true;
+    }
+
+    // runs the live passes; leaves the default framebuffer bound with a full-window viewport
+    void execute()
+    {
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            PassNode &pass = passes[order[i]];
+            glBindFramebuffer(GL_FRAMEBUFFER, pass.FBO);
+            const RenderTextureDesc &target = resources[pass.Writes[0]].Desc;
+            glViewport(0, 0, target.Width, target.Height);
+            clearFirstWrites(pass, (int)i);
+            pass.Execute();
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, screenWidth, screenHeight);
+    }
+
+    const RenderTextureDesc &desc(int resource) const
+    {
+        return resources[resource].Desc;
+    }
+    // the GL texture behind a transient resource in this frame, for sampling within a pass
+    unsigned int texture(int resource) const
+    {
+        const ResourceNode &r = resources[resource];
+        return r.Imported || r.Physical < 0 ? 0 : pool[r.Physical].Texture;
+    }
+    // a framebuffer with only 'resource' attached, e.g. to bind as GL_READ_FRAMEBUFFER for a
+    // blit; the backbuffer is 0
+    unsigned int framebuffer(int resource)
+    {
+        unsigned int tex = texture(resource);
+        if (tex == 0)
+            return 0;
+        std::vector<unsigned int> colors;
+        unsigned int depth = 0;
+        if (isDepthFormat(resources[resource].Desc.Format))
+            depth = tex;
+        else
+            colors.push_back(tex);
+        return findFramebuffer(colors, depth, resources[resource].Desc.Format);
+    }
+
+private:
+    struct ResourceNode
+    {
+        std::string Name;
+        RenderTextureDesc Desc;
+        bool Imported;
+        int First, Last;        // positions in 'order' of the first and last live use
+        int Physical;           // index in 'pool', -1 if not allocated
+    };
+    struct PassNode
+    {
+        std::string Name;
+        std::function<void()> Execute;
+        std::vector<int> Reads, Writes;
+        bool Live;
+        unsigned int FBO;
+    };
+    struct PooledTexture
+    {
+        unsigned int Texture;
+        RenderTextureDesc Desc;
+        int BusyUntil;          // last position in 'order' of its owner this frame
+        unsigned long long LastUsed;
+    };
+    struct CachedFramebuffer
+    {
+        unsigned int FBO;
+        std::vector<unsigned int> Colors;
+        unsigned int Depth;
+        unsigned long long LastUsed;
+    };
+
+    std::vector<ResourceNode> resources;
+    std::vector<PassNode> passes;
+    std::vector<int> order;             // live passes in execution order
+    std::vector<PooledTexture> pool;
+    std::vector<CachedFramebuffer> framebuffers;
+    int screenWidth, screenHeight;
+    unsigned long long frame;
+
+    static void addUnique(std::vector<int> &list, int value)
+    {
+        for (size_t i = 0; i < list.size(); i++)
+            if (list[i] == value)
+                return;
+        list.push_back(value);
+    }
+
+    static bool isDepthFormat(GLenum format)
+    {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F || hasStencil(format);
+    }
+    static bool hasStencil(GLenum format)
+    {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    // topological order, earliest declared first among the passes that are ready
+    bool sortPasses()
+    {
+        size_t n = passes.size();
+        std::vector<std::vector<int> > next(n);
+        std::vector<int> waiting(n, 0);
+        for (size_t r = 0; r < resources.size(); r++)
+        {
+            int lastWriter = -1;
+            for (size_t p = 0; p < n; p++)
+            {
+                if (!contains(passes[p].Writes, (int)r))
+                    continue;
+                if (contains(passes[p].Reads, (int)r))
+                {
+                    std::cout << "ERROR::RENDER_GRAPH::FEEDBACK_LOOP " << passes[p].Name << " reads and writes " << resources[r].Name << std::endl;
+                    return false;
+                }
+                if (lastWriter >= 0)
+                {
+                    next[lastWriter].push_back((int)p);
+                    waiting[p]++;
+                }
+                lastWriter = (int)p;
+            }
+            for (size_t p = 0; p < n; p++)
+            {
+                if (!contains(passes[p].Reads, (int)r))
+                    continue;
+                if (lastWriter < 0)
+                {
+                    if (!resources[r].Imported)
+                    {
+                        std::cout << "ERROR::RENDER_GRAPH::READ_BEFORE_WRITE " << passes[p].Name << " reads " << resources[r].Name << std::endl;
+                        return false;
+                    }
+                    continue;
+                }
+                next[lastWriter].push_back((int)p);
+                waiting[p]++;
+            }
+        }
+
+        std::priority_queue<int, std::vector<int>, std::greater<int> > ready;
+        for (size_t p = 0; p < n; p++)
+            if (waiting[p] == 0)
+                ready.push((int)p);
+        std::vector<int> sorted;
+        while (!ready.empty())
+        {
+            int p = ready.top();
+            ready.pop();
+            sorted.push_back(p);
+            for (size_t e = 0; e < next[p].size(); e++)
+                if (--waiting[next[p][e]] == 0)
+                    ready.push(next[p][e]);
+        }
+        if (sorted.size() != n)
+        {
+            std::cout << "ERROR::RENDER_GRAPH::CYCLE" << std::endl;
+            return false;
+        }
+        order = sorted;
+        return true;
+    }
+
+    // walking backwards, a pass is live if it writes the backbuffer or something a live pass
+    // reads; 'order' keeps only the live passes
+    void cullPasses()
+    {
+        std::vector<bool> needed(resources.size(), false);
+        needed[RG_BACKBUFFER] = true;
+        for (size_t i = order.size(); i-- > 0;)
+        {
+            PassNode &pass = passes[order[i]];
+            pass.Live = false;
+            for (size_t w = 0; w < pass.Writes.size(); w++)
+                pass.Live = pass.Live || needed[pass.Writes[w]];
+            if (!pass.Live)
+                continue;
+            for (size_t r = 0; r < pass.Reads.size(); r++)
+                needed[pass.Reads[r]] = true;
+        }
+        std::vector<int> live;
+        for (size_t i = 0; i < order.size(); i++)
+            if (passes[order[i]].Live)
+                live.push_back(order[i]);
+        order = live;
+    }
+
+    // lifetimes over the live passes, then a pooled texture for each transient resource in
+    // order of first use: any texture of the same description whose owner's last use is
+    // already behind it, else a new one
+    void allocateTextures()
+    {
+        for (size_t r = 0; r < resources.size(); r++)
+        {
+            resources[r].First = -1;
+            resources[r].Last = -1;
+            resources[r].Physical = -1;
+        }
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const PassNode &pass = passes[order[i]];
+            for (size_t k = 0; k < pass.Reads.size() + pass.Writes.size(); k++)
+            {
+                int r = k < pass.Reads.size() ? pass.Reads[k] : pass.Writes[k - pass.Reads.size()];
+                if (resources[r].First < 0)
+                    resources[r].First = (int)i;
+                resources[r].Last = (int)i;
+            }
+        }
+        for (size_t t = 0; t < pool.size(); t++)
+            pool[t].BusyUntil = -1;
+
+        Transients = 0;
+        Textures = 0;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            for (size_t r = 0; r < resources.size(); r++)
+            {
+                ResourceNode &resource = resources[r];
+                if (resource.Imported || resource.First != (int)i)
+                    continue;
+                Transients++;
+                int chosen = -1;
+                for (size_t t = 0; t < pool.size() && chosen < 0; t++)
+                    if (pool[t].BusyUntil < resource.First && sameDesc(pool[t].Desc, resource.Desc))
+                        chosen = (int)t;
+                if (chosen < 0)
+                {
+                    pool.push_back(createTexture(resource.Desc));
+                    chosen = (int)pool.size() - 1;
+                }
+                if (pool[chosen].LastUsed != frame)
+                    Textures++;
+                pool[chosen].BusyUntil = resource.Last;
+                pool[chosen].LastUsed = frame;
+                resource.Physical = chosen;
+            }
+        }
+    }
+
+    static bool sameDesc(const RenderTextureDesc &a, const RenderTextureDesc &b)
+    {
+        return a.Width == b.Width && a.Height == b.Height && a.Format == b.Format;
+    }
+
+    static bool contains(const std::vector<int> &list, int value)
+    {
+        for (size_t i = 0; i < list.size(); i++)
+            if (list[i] == value)
+                return true;
+        return false;
+    }
+
+    PooledTexture createTexture(const RenderTextureDesc &desc)
+    {
+        PooledTexture t;
+        t.Desc = desc;
+        t.BusyUntil = -1;
+        t.LastUsed = frame;
+        GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+        if (hasStencil(desc.Format))
+        {
+            format = GL_DEPTH_STENCIL;
+            type = desc.Format == GL_DEPTH32F_STENCIL8 ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV : GL_UNSIGNED_INT_24_8;
+        }
+        else if (isDepthFormat(desc.Format))
+        {
+            format = GL_DEPTH_COMPONENT;
+            type = GL_FLOAT;
+        }
+        glGenTextures(1, &t.Texture);
+        glState().bindTexture(t.Texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.Format, desc.Width, desc.Height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glState().bindTexture(0);
+        return t;
+    }
+
+    // drops textures and framebuffers that no graph has used for RG_POOL_FRAMES frames,
+    // e.g. after a resize; framebuffers go with any texture they reference
+    void releaseUnused()
+    {
+        std::vector<unsigned int> released;
+        for (size_t t = 0; t < pool.size();)
+        {
+            if (frame - pool[t].LastUsed <= RG_POOL_FRAMES)
+            {
+                t++;
+                continue;
+            }
+            released.push_back(pool[t].Texture);
+            glState().forgetTexture(pool[t].Texture);
+            glDeleteTextures(1, &pool[t].Texture);
+            pool.erase(pool.begin() + t);
+        }
+        for (size_t f = 0; f < framebuffers.size();)
+        {
+            const CachedFramebuffer &fb = framebuffers[f];
+            bool stale = frame - fb.LastUsed > RG_POOL_FRAMES;
+            for (size_t k = 0; k < released.size() && !stale; k++)
+                stale = fb.Depth == released[k] || std::find(fb.Colors.begin(), fb.Colors.end(), released[k]) != fb.Colors.end();
+            if (!stale)
+            {
+                f++;
+                continue;
+            }
+            glDeleteFramebuffers(1, &framebuffers[f].FBO);
+            framebuffers.erase(framebuffers.begin() + f);
+        }
+    }
+
+    bool buildFramebuffer(PassNode &pass)
+    {
+        pass.FBO = 0;
+        if (pass.Writes.empty())
+        {
+            std::cout << "ERROR::RENDER_GRAPH::NO_TARGET " << pass.Name << std::endl;
+            return false;
+        }
+        if (contains(pass.Writes, RG_BACKBUFFER))
+        {
+            if (pass.Writes.size() > 1)
+            {
+                std::cout << "ERROR::RENDER_GRAPH::MIXED_BACKBUFFER " << pass.Name << std::endl;
+                return false;
+            }
+            return true;
+        }
+        std::vector<unsigned int> colors;
+        unsigned int depth = 0;
+        GLenum depthFormat = GL_NONE;
+        for (size_t w = 0; w < pass.Writes.size(); w++)
+        {
+            const ResourceNode &r = resources[pass.Writes[w]];
+            if (isDepthFormat(r.Desc.Format))
+            {
+                depth = pool[r.Physical].Texture;
+                depthFormat = r.Desc.Format;
+            }
+            else
+                colors.push_back(pool[r.Physical].Texture);
+        }
+        pass.FBO = findFramebuffer(colors, depth, depthFormat);
+        return pass.FBO != 0;
+    }
+
+    // a cached framebuffer with exactly these attachments, created on first use; the current
+    // framebuffer bindings are left as they were
+    unsigned int findFramebuffer(const std::vector<unsigned int> &colors, unsigned int depth, GLenum depthFormat)
+    {
+        for (size_t f = 0; f < framebuffers.size(); f++)
+            if (framebuffers[f].Colors == colors && framebuffers[f].Depth == depth)
+            {
+                framebuffers[f].LastUsed = frame;
+                return framebuffers[f].FBO;
+            }
+
+        GLint drawBinding = 0, readBinding = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawBinding);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readBinding);
+        CachedFramebuffer fb;
+        fb.Colors = colors;
+        fb.Depth = depth;
+        fb.LastUsed = frame;
+        glGenFramebuffers(1, &fb.FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, fb.FBO);
+        std::vector<GLenum> drawBuffers;
+        for (size_t c = 0; c < colors.size(); c++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)c, GL_TEXTURE_2D, colors[c], 0);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)c);
+        }
+        if (depth)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, hasStencil(depthFormat) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if (drawBuffers.empty())
+        {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        else
+            glDrawBuffers((GLsizei)drawBuffers.size(), &drawBuffers[0]);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawBinding);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readBinding);
+        if (!complete)
+        {
+            std::cout << "ERROR::RENDER_GRAPH::FRAMEBUFFER_INCOMPLETE" << std::endl;
+            glDeleteFramebuffers(1, &fb.FBO);
+            return 0;
+        }
+        framebuffers.push_back(fb);
+        return fb.FBO;
+    }
+
+    // clears what this pass is the first to touch; the backbuffer clears color and depth
+    void clearFirstWrites(const PassNode &pass, int position)
+    {
+        bool cleared = false;
+        int color = 0;
+        for (size_t w = 0; w < pass.Writes.size(); w++)
+        {
+            const ResourceNode &r = resources[pass.Writes[w]];
+            bool depth = isDepthFormat(r.Desc.Format);
+            bool first = r.First == position;
+            if (first && !cleared)
+            {
+                glState().colorMask(true);
+                glState().depthMask(true);
+                cleared = true;
+            }
+            if (first && (r.Imported || !depth))
+                glClearBufferfv(GL_COLOR, color, &ClearColor[0]);
+            if (first && (r.Imported || depth))
+                glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+            if (!depth)
+                color++;
+        }
+    }
+};
+#endif
@@ -0,0 +1,447 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "shader_m.h"
+#include "gl_state.h"
+#include "indirect_draw.h"
+#include "instancing.h"
+#include "material.h"
+#include "frame_uniforms.h"
+
+#include <vector>
+#include <cstring>
+
+// Layout of the 64-bit sort key, most significant field first. The top bits hold the
+// MaterialClass, so opaque, alpha-tested and blended packets form three passes in that
+// order. In the first two, state changes cost more than overdraw, so program, texture and
+// VAO come before depth; within one state the packets end up front to back, which lets
+// early-z reject hidden fragments:
+//   63..62  pass      (MaterialClass)
+//   61..50  program   (index in the queue's program table)
+//   49..36  texture   (index in the queue's texture table)
+//   35..24  VAO       (index in the queue's VAO table)
+//   23..0   depth     (view distance / DepthRange, quantized)
+// Blended packets must be drawn back to front to composite correctly, so for them the
+// inverted depth moves right below the pass and the state only breaks ties:
+//   63..62  pass
+//   61..38  RQ_DEPTH_MAX - depth
+//   37..26  program
+//   25..12  texture
+//   11..0   VAO
+const int RQ_PASS_SHIFT    = 62;
+const int RQ_PROGRAM_SHIFT = 50;
+const int RQ_TEXTURE_SHIFT = 36;
+const int RQ_VAO_SHIFT     = 24;
+const int RQ_BLENDED_DEPTH_SHIFT = 38;
+const unsigned int RQ_DEPTH_MAX = (1u << 24) - 1;
+
+// one draw submitted to the queue
+struct DrawPacket
+{
+    Shader *Program;
+    unsigned int Texture;
+    unsigned int VAO;
+    unsigned int DepthVAO;          // position-only VAO for the depth pre-pass, 0 to skip it
+    float Depth;                    // distance from the camera
+    MaterialClass Pass;
+    GLint First;                    // vertex range for a plain draw...
+    GLsizei Count;
+    InstancedMesh *Instances;       // ...or an instanced mesh, which brings its own VAO
+    const glm::mat4 *Model;         // optional, passed in the ObjectData block if not null
+    const glm::mat3 *NormalMatrix;  // identity if null
+};
+
+// Collects the draws of a frame, radix sorts them by their 64-bit key and submits them
+// with as few state changes as possible. Runs of plain draws that share program, texture,
+// VAO and transform are merged into one indirect multi-draw. The transforms of the frame are
+// copied into TransformRing in prepare() and bound as a range of it per draw, instead of
+// being set as uniforms of every program that draws them.
+//
+// A slot hidden with hide() keeps the packet and key it last had, so it keeps its place in
+// the sorted list and its indirect command, which only drops to zero instances. An object
+// entering or leaving the view therefore re-uploads one command instead of shifting every
+// command after it. Hidden packets cause no state changes and no draws.
+//
+// With DepthPrepass set, the opaque packets are first drawn depth-only with color writes
+// off, then shaded with GL_EQUAL depth testing and depth writes off, so the expensive
+// fragment shaders run once per visible pixel. Opaque packets without a DepthVAO, and the
+// alpha-tested and blended passes, are drawn as usual.
+class RenderQueue
+{
+public:
+    // distance that maps to the largest depth key, normally the far plane
+    float DepthRange;
+    // packets drawn and hidden, state changes and draw calls of the last submit()
+    unsigned int Packets, Culled, ProgramChanges, Draws;
+    // depth pre-pass; both programs must be set for it to run
+    bool DepthPrepass;
+    Shader *DepthProgram;           // for plain draws
+    Shader *DepthInstancedProgram;  // for instanced meshes
+    // per-frame ring for the ObjectData blocks; needed if any packet sets a Model
+    FrameRingBuffer *TransformRing;
+
+    RenderQueue(float depthRange = 100.0f) : DepthRange(depthRange), Packets(0), Culled(0), ProgramChanges(0), Draws(0), DepthPrepass(false), DepthProgram(nullptr), DepthInstancedProgram(nullptr), TransformRing(nullptr), prepassed(false), boundTransform(-1)
+    {
+    }
+
+    void clear()
+    {
+        packets.clear();
+        slotKeys.clear();
+        hidden.clear();
+    }
+
+    void push(const DrawPacket &packet)
+    {
+        intern(programs, packet.Program);
+        intern(textures, packet.Texture);
+        intern(vaos, packet.Instances ? packet.Instances->VAO : packet.VAO);
+        slotKeys.push_back(makeKey(packet));
+        hidden.push_back(0);
+        packets.push_back(packet);
+    }
+
+    // Parallel filling: resize() on the submitting thread, then set() or hide() every slot
+    // from any thread. set() only reads the program, texture and VAO tables, so everything
+    // the packets use should be registered beforehand; unregistered state still draws
+    // correctly but sorts after the registered state of its pass.
+    void registerProgram(Shader *program)
+    {
+        intern(programs, program);
+    }
+    void registerTexture(unsigned int texture)
+    {
+        intern(textures, texture);
+    }
+    void registerVAO(unsigned int vao)
+    {
+        intern(vaos, vao);
+    }
+    // new slots start out hidden
+    void resize(size_t count)
+    {
+        packets.resize(count);
+        slotKeys.resize(count, 0);
+        hidden.resize(count, 1);
+    }
+    void set(size_t index, const DrawPacket &packet)
+    {
+        packets[index] = packet;
+        slotKeys[index] = makeKey(packet);
+        hidden[index] = 0;
+    }
+    // the slot is not drawn this frame but keeps its packet, key and command slot
+    void hide(size_t index)
+    {
+        hidden[index] = 1;
+    }
+
+    // sorts and draws everything pushed or set since the last clear() / resize()
+    void submit()
+    {
+        prepare();
+        if (DepthPrepass)
+            drawDepth();
+        drawPasses(MATERIAL_OPAQUE, MATERIAL_BLENDED);
+    }
+
+    // The steps of submit(), for callers that put other work between the passes: prepare()
+    // once, then optionally drawDepth() and drawPasses() for each range of passes, in order.
+    void prepare()
+    {
+        keys.resize(packets.size());
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            keys[i].Key = slotKeys[i];
+            keys[i].Index = (unsigned int)i;
+        }
+        sort();
+        Culled = 0;
+        for (size_t i = 0; i < hidden.size(); i++)
+            Culled += hidden[i] ? 1 : 0;
+        Packets = (unsigned int)(packets.size() - Culled);
+        ProgramChanges = 0;
+        Draws = 0;
+
+        // one indirect command per plain draw, in sorted order; the command is written first
+        // with its current visibility, so a slot that only toggles changes in setVisible()
+        commands.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            const DrawPacket &p = packets[keys[i].Index];
+            if (p.Instances)
+            {
+                commands.setCommand(i, 0, 0, 0);
+                continue;
+            }
+            commands.setCommand(i, p.First, p.Count, commands.Commands[i].InstanceCount);
+            commands.setVisible(i, !hidden[keys[i].Index]);
+        }
+        commands.upload();
+        writeTransforms();
+        prepassed = false;
+    }
+
+    // lays down the depth of the opaque packets; needs both depth programs
+    void drawDepth()
+    {
+        if (!DepthProgram || !DepthInstancedProgram)
+            return;
+        depthPrepass();
+        prepassed = true;
+    }
+
+    // draws the packets of the passes first..last (MaterialClass values)
+    void drawPasses(MaterialClass first, MaterialClass last)
+    {
+        size_t i = 0;
+        while (i < keys.size() && packets[keys[i].Index].Pass < first)
+            i++;
+        size_t end = i;
+        while (end < keys.size() && packets[keys[end].Index].Pass <= last)
+            end++;
+
+        Shader *current = nullptr;
+        while (i < end)
+        {
+            if (hidden[keys[i].Index])
+            {
+                i++;
+                continue;
+            }
+            const DrawPacket &p = packets[keys[i].Index];
+            setPassState(p.Pass, prepassed && hasDepth(p));
+            if (p.Program != current)
+            {
+                current = p.Program;
+                current->use();
+                ProgramChanges++;
+            }
+            bindTransform(transforms[i]);
+            glState().bindTexture(p.Texture);
+            Draws++;
+
+            if (p.Instances)
+            {
+                p.Instances->draw();
+                i++;
+                continue;
+            }
+            size_t run = this->run(i, end);
+            glState().bindVertexArray(p.VAO);
+            commands.draw(i, run);
+            i += run;
+        }
+        // leave the opaque state behind for whatever is drawn after the queue
+        setPassState(MATERIAL_OPAQUE, false);
+    }
+
+private:
+    struct SortEntry
+    {
+        unsigned long long Key;
+        unsigned int Index;
+    };
+
+    std::vector<DrawPacket> packets;
+    std::vector<unsigned long long> slotKeys;   // per slot, as of its last set()
+    std::vector<unsigned char> hidden;          // bytes, so jobs can write neighbouring slots
+    std::vector<SortEntry> keys;                // sorted in prepare()
+    std::vector<SortEntry> scratch;
+    std::vector<Shader *> programs;
+    std::vector<unsigned int> textures;
+    std::vector<unsigned int> vaos;
+    IndirectDrawBuffer commands;
+    std::vector<GLintptr> transforms;   // per sorted position, offset in TransformRing or -1
+    bool prepassed;         // drawDepth() ran since the last prepare()
+    GLintptr boundTransform;
+
+    // small dense index for a program, texture or VAO; the tables only grow
+    template <typename T>
+    static unsigned int intern(std::vector<T> &table, T value)
+    {
+        unsigned int index = lookup(table, value, 0xFFFFFFFFu);
+        if (index != 0xFFFFFFFFu)
+            return index;
+        table.push_back(value);
+        return (unsigned int)table.size() - 1;
+    }
+    // read-only variant, 'missing' if the value was never interned
+    template <typename T>
+    static unsigned int lookup(const std::vector<T> &table, T value, unsigned int missing)
+    {
+        for (size_t i = 0; i < table.size(); i++)
+            if (table[i] == value)
+                return (unsigned int)i;
+        return missing;
+    }
+
+    // see the key layout above; only reads the tables, so it is safe to call concurrently
+    unsigned long long makeKey(const DrawPacket &packet) const
+    {
+        float d = packet.Depth / DepthRange;
+        d = d < 0.0f ? 0.0f : (d > 1.0f ? 1.0f : d);
+        unsigned long long depth = (unsigned long long)(d * RQ_DEPTH_MAX);
+        // unknown state takes the largest index of its field
+        unsigned long long state = 0;
+        state |= (unsigned long long)lookup(programs, packet.Program, 0xFFF) << (RQ_PROGRAM_SHIFT - RQ_VAO_SHIFT);
+        state |= (unsigned long long)lookup(textures, packet.Texture, 0x3FFF) << (RQ_TEXTURE_SHIFT - RQ_VAO_SHIFT);
+        state |= (unsigned long long)lookup(vaos, packet.Instances ? packet.Instances->VAO : packet.VAO, 0xFFF);
+
+        unsigned long long key = (unsigned long long)packet.Pass << RQ_PASS_SHIFT;
+        if (packet.Pass == MATERIAL_BLENDED)
+            key |= ((RQ_DEPTH_MAX - depth) << RQ_BLENDED_DEPTH_SHIFT) | state;
+        else
+            key |= (state << RQ_VAO_SHIFT) | depth;
+        return key;
+    }
+
+    static bool mergeable(const DrawPacket &a, const DrawPacket &b)
+    {
+        return !b.Instances && a.Pass == b.Pass && a.Program == b.Program && a.Texture == b.Texture && a.VAO == b.VAO && a.DepthVAO == b.DepthVAO && a.Model == b.Model && a.NormalMatrix == b.NormalMatrix;
+    }
+    // length of the multi-draw starting at sorted position i: the following packets that
+    // share its state, and hidden plain packets, whose commands draw nothing
+    size_t run(size_t i, size_t end) const
+    {
+        const DrawPacket &p = packets[keys[i].Index];
+        size_t n = 1;
+        while (i + n < end)
+        {
+            const DrawPacket &next = packets[keys[i + n].Index];
+            if (!mergeable(p, next) && (next.Instances || !hidden[keys[i + n].Index]))
+                break;
+            n++;
+        }
+        return n;
+    }
+    // copies the transforms of the visible plain packets into this frame's ring region; a
+    // run of packets that share one transform shares one copy, so they still merge
+    void writeTransforms()
+    {
+        transforms.assign(keys.size(), -1);
+        boundTransform = -1;
+        if (!TransformRing)
+            return;
+        const glm::mat4 *model = nullptr;
+        const glm::mat3 *normalMatrix = nullptr;
+        GLintptr offset = -1;
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            const DrawPacket &p = packets[keys[i].Index];
+            if (p.Instances || !p.Model || hidden[keys[i].Index])
+                continue;
+            if (p.Model != model || p.NormalMatrix != normalMatrix)
+            {
+                model = p.Model;
+                normalMatrix = p.NormalMatrix;
+                offset = writeObjectData(*TransformRing, *model, normalMatrix ? *normalMatrix : glm::mat3(1.0f));
+            }
+            transforms[i] = offset;
+        }
+        TransformRing->commit();
+    }
+    void bindTransform(GLintptr offset)
+    {
+        if (offset < 0 || offset == boundTransform)
+            return;
+        glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_UNIFORM_BINDING, TransformRing->Buffer, offset, sizeof(ObjectData));
+        boundTransform = offset;
+    }
+    static bool hasDepth(const DrawPacket &p)
+    {
+        return p.Pass == MATERIAL_OPAQUE && (p.Instances || p.DepthVAO);
+    }
+
+    // blending is on, and depth writes are off, only while blended geometry is drawn; geometry
+    // already in the depth buffer from the pre-pass only passes where its depth is equal
+    static void setPassState(int pass, bool prepassed)
+    {
+        if (pass == MATERIAL_BLENDED)
+        {
+            glState().enable(GL_BLEND);
+            glState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glState().depthFunc(GL_LESS);
+            glState().depthMask(false);
+        }
+        else if (prepassed)
+        {
+            glState().disable(GL_BLEND);
+            glState().depthFunc(GL_EQUAL);
+            glState().depthMask(false);
+        }
+        else
+        {
+            glState().disable(GL_BLEND);
+            glState().depthFunc(GL_LESS);
+            glState().depthMask(true);
+        }
+    }
+
+    // lays down the depth of the opaque packets, which sort first, front to back per state
+    void depthPrepass()
+    {
+        glState().colorMask(false);
+        setPassState(MATERIAL_OPAQUE, false);
+        size_t end = 0;
+        while (end < keys.size() && packets[keys[end].Index].Pass == MATERIAL_OPAQUE)
+            end++;
+        for (size_t i = 0; i < end;)
+        {
+            const DrawPacket &p = packets[keys[i].Index];
+            if (hidden[keys[i].Index] || !hasDepth(p))
+            {
+                i++;
+                continue;
+            }
+            Draws++;
+            if (p.Instances)
+            {
+                DepthInstancedProgram->use();
+                p.Instances->draw(true);
+                i++;
+                continue;
+            }
+            DepthProgram->use();
+            bindTransform(transforms[i]);
+            size_t run = this->run(i, end);
+            glState().bindVertexArray(p.DepthVAO);
+            commands.draw(i, run);
+            i += run;
+        }
+        glState().colorMask(true);
+    }
+
+    // LSD radix sort on 8-bit digits; digits on which all keys agree are skipped, so with
+    // few programs and textures most of the eight passes cost one histogram only
+    void sort()
+    {
+        size_t n = keys.size();
+        if (n < 2)
+            return;
+        scratch.resize(n);
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            unsigned int histogram[256];
+            std::memset(histogram, 0, sizeof(histogram));
+            for (size_t i = 0; i < n; i++)
+                histogram[(keys[i].Key >> shift) & 0xFF]++;
+            if (histogram[(keys[0].Key >> shift) & 0xFF] == n)
+                continue;
+            unsigned int offset = 0;
+            for (int b = 0; b < 256; b++)
+            {
+                unsigned int c = histogram[b];
+                histogram[b] = offset;
+                offset += c;
+            }
+            for (size_t i = 0; i < n; i++)
+                scratch[histogram[(keys[i].Key >> shift) & 0xFF]++] = keys[i];
+            keys.swap(scratch);
+        }
+    }
+};
+#endif
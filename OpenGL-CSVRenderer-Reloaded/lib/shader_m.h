@@ -6,23 +6,105 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include "gl_state.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <iterator>
+
+#ifdef _WIN32
+#include <direct.h>
+#define SHADER_MKDIR(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define SHADER_MKDIR(path) mkdir(path, 0755)
+#endif
+
+// linked program binaries are cached here, keyed by source and driver
+#define SHADER_CACHE_DIR "shader_cache"
+
+// FNV-1a hash of a uniform name; constexpr so literal names are hashed at compile time
+constexpr unsigned int uniformHash(const char *str, unsigned int hash = 2166136261u)
+{
+    return *str ? uniformHash(str + 1, (hash ^ (unsigned char)*str) * 16777619u) : hash;
+}
+
+// a uniform name reduced to its hash; the set* functions take this instead of a string so
+// lookups never touch the characters again
+struct UniformName
+{
+    unsigned int Hash;
+
+    constexpr UniformName(const char *name) : Hash(uniformHash(name)) {}
+    UniformName(const std::string &name) : Hash(uniformHash(name.c_str())) {}
+};
+
+// typed handle for an active uniform, resolved once after linking
+struct UniformHandle
+{
+    int Location;
+    GLenum Type;
+    int Index;  // slot in the owning Shader's uniform table
+};
+
+// a program whose compile/link may still be running, see Shader::beginBuild
+struct ProgramBuild
+{
+    unsigned int Program;
+    unsigned int Vertex, Fragment, Geometry;
+    std::string CacheFile;
+    bool FromCache;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
+    // source files, kept so the program can be rebuilt when they change
+    std::string VertexPath;
+    std::string FragmentPath;
+    std::string GeometryPath;
+    // "#define" lines injected after the #version line of every stage
+    std::string Defines;
+    // files pulled in through #include by the last readSources()
+    std::vector<std::string> IncludedPaths;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string &defines = "") : VertexPath(vertexPath), FragmentPath(fragmentPath), GeometryPath(geometryPath ? geometryPath : ""), Defines(defines)
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
+        readSources(vertexCode, fragmentCode, geometryCode);
+        // 2. build the program, from the binary cache when the driver already has it
+        ID = build(vertexCode, fragmentCode, geometryCode);
+        // 3. resolve every active uniform once so the setters never query GL by name
+        enumerateUniforms();
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use()
+    {
+        glState().useProgram(ID);
+    }
+    // attaches the named uniform block to a buffer binding point; ignored if the program doesn't use it
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const char *blockName, unsigned int binding)
+    {
+        blockBindings.push_back(std::make_pair(std::string(blockName), binding));
+        applyBlockBinding(blockName, binding);
+    }
+    // reads the current contents of the source files; false if any of them can't be read
+    // ------------------------------------------------------------------------
+    bool readSources(std::string &vertexCode, std::string &fragmentCode, std::string &geometryCode)
+    {
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -33,8 +115,8 @@ public:
         try
         {
             // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
+            vShaderFile.open(VertexPath.c_str());
+            fShaderFile.open(FragmentPath.c_str());
             std::stringstream vShaderStream, fShaderStream;
             // read file's buffer contents into streams
             vShaderStream << vShaderFile.rdbuf();
@@ -46,9 +128,9 @@ public:
             vertexCode = vShaderStream.str();
             fragmentCode = fShaderStream.str();
             // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
+            if(!GeometryPath.empty())
             {
-                gShaderFile.open(geometryPath);
+                gShaderFile.open(GeometryPath.c_str());
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
@@ -58,115 +140,422 @@ public:
         catch (std::ifstream::failure& e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            return false;
+        }
+        // GLSL has no #include, so shared code such as the lighting model is spliced in here
+        IncludedPaths.clear();
+        if (!expandIncludes(vertexCode, VertexPath, IncludedPaths) ||
+            !expandIncludes(fragmentCode, FragmentPath, IncludedPaths) ||
+            (!geometryCode.empty() && !expandIncludes(geometryCode, GeometryPath, IncludedPaths)))
+            return false;
+        if (!Defines.empty())
+        {
+            injectDefines(vertexCode, Defines);
+            injectDefines(fragmentCode, Defines);
+            if (!geometryCode.empty())
+                injectDefines(geometryCode, Defines);
+        }
+        return true;
+    }
+    // replaces the program with a newly linked one built from the same files. The old
+    // program is deleted, uniforms are re-resolved and uniform block bindings re-applied.
+    // ------------------------------------------------------------------------
+    void swapProgram(unsigned int program)
+    {
+        glState().forgetProgram(ID);
+        glDeleteProgram(ID);
+        ID = program;
+        enumerateUniforms();
+        for (size_t i = 0; i < blockBindings.size(); i++)
+            applyBlockBinding(blockBindings[i].first.c_str(), blockBindings[i].second);
+    }
+    // replaces every '#include "file"' line with the contents of that file, resolved relative
+    // to the including file. Each file is spliced at most once per stage, which also stops cycles.
+    // ------------------------------------------------------------------------
+    static bool expandIncludes(std::string &code, const std::string &path, std::vector<std::string> &includedPaths)
+    {
+        std::vector<std::string> seen;
+        return expandIncludes(code, path, includedPaths, seen);
+    }
+    static bool expandIncludes(std::string &code, const std::string &path, std::vector<std::string> &includedPaths, std::vector<std::string> &seen)
+    {
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        size_t pos = 0;
+        while ((pos = code.find("#include", pos)) != std::string::npos)
+        {
+            size_t eol = code.find('\n', pos);
+            if (eol == std::string::npos)
+                eol = code.size();
+            size_t open = code.find('"', pos);
+            size_t close = open == std::string::npos ? open : code.find('"', open + 1);
+            if (close == std::string::npos || close > eol)
+            {
+                std::cout << "ERROR::SHADER::BAD_INCLUDE in " << path << std::endl;
+                return false;
+            }
+            std::string includePath = directory + code.substr(open + 1, close - open - 1);
+            std::string included;
+            if (std::find(seen.begin(), seen.end(), includePath) == seen.end())
+            {
+                seen.push_back(includePath);
+                std::ifstream file(includePath.c_str());
+                if (!file)
+                {
+                    std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << includePath << std::endl;
+                    return false;
+                }
+                std::stringstream stream;
+                stream << file.rdbuf();
+                included = stream.str();
+                if (std::find(includedPaths.begin(), includedPaths.end(), includePath) == includedPaths.end())
+                    includedPaths.push_back(includePath);
+                if (!expandIncludes(included, includePath, includedPaths, seen))
+                    return false;
+            }
+            code.replace(pos, eol - pos, included);
+            pos += included.size();
+        }
+        return true;
+    }
+    // inserts the defines right after the #version line, which must stay first
+    // ------------------------------------------------------------------------
+    static void injectDefines(std::string &code, const std::string &defines)
+    {
+        size_t version = code.find("#version");
+        if (version == std::string::npos)
+        {
+            code.insert(0, defines);
+            return;
         }
+        size_t eol = code.find('\n', version);
+        if (eol == std::string::npos)
+            code += "\n" + defines;
+        else
+            code.insert(eol + 1, defines);
+    }
+    // compiles and links the sources into a new program, or loads the program from the
+    // binary cache when a binary for these exact sources and this driver exists
+    // ------------------------------------------------------------------------
+    static unsigned int build(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode)
+    {
+        ProgramBuild b = beginBuild(vertexCode, fragmentCode, geometryCode);
+        finishBuild(b);
+        return b.Program;
+    }
+    // issues the compile and link without waiting for them, so a driver with parallel shader
+    // compilation can work in the background; finishBuild() collects the result
+    // ------------------------------------------------------------------------
+    static ProgramBuild beginBuild(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode)
+    {
+        ProgramBuild b;
+        b.Program = glCreateProgram();
+        b.Vertex = b.Fragment = b.Geometry = 0;
+        b.CacheFile = binaryCachePath(vertexCode, fragmentCode, geometryCode);
+        b.FromCache = !b.CacheFile.empty() && loadBinary(b.Program, b.CacheFile);
+        if (b.FromCache)
+            return b;
+
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
         // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+        b.Vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(b.Vertex, 1, &vShaderCode, NULL);
+        glCompileShader(b.Vertex);
         // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        b.Fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(b.Fragment, 1, &fShaderCode, NULL);
+        glCompileShader(b.Fragment);
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        if(!geometryCode.empty())
         {
             const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            b.Geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(b.Geometry, 1, &gShaderCode, NULL);
+            glCompileShader(b.Geometry);
         }
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        glAttachShader(b.Program, b.Vertex);
+        glAttachShader(b.Program, b.Fragment);
+        if(b.Geometry)
+            glAttachShader(b.Program, b.Geometry);
+        if (!b.CacheFile.empty())
+            glProgramParameteri(b.Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(b.Program);
+        return b;
+    }
+    // reports compile/link errors, releases the shader objects and stores the binary in the
+    // cache; returns whether the program linked
+    // ------------------------------------------------------------------------
+    static bool finishBuild(ProgramBuild &b)
+    {
+        if (b.FromCache)
+            return true;
+        checkCompileErrors(b.Vertex, "VERTEX");
+        checkCompileErrors(b.Fragment, "FRAGMENT");
+        if(b.Geometry)
+            checkCompileErrors(b.Geometry, "GEOMETRY");
+        bool linked = checkCompileErrors(b.Program, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
+        glDeleteShader(b.Vertex);
+        glDeleteShader(b.Fragment);
+        if(b.Geometry)
+            glDeleteShader(b.Geometry);
+        b.Vertex = b.Fragment = b.Geometry = 0;
 
+        if (linked && !b.CacheFile.empty())
+            saveBinary(b.Program, b.CacheFile);
+        return linked;
     }
-    // activate the shader
+    // uniform lookup
     // ------------------------------------------------------------------------
-    void use()
+    int location(UniformName name) const
     {
-        glUseProgram(ID);
+        int index = find(name);
+        return index < 0 ? -1 : uniforms[index].Location;
     }
-    // utility uniform functions
+    UniformHandle uniform(UniformName name) const
+    {
+        int index = find(name);
+        if (index < 0)
+            return UniformHandle{-1, GL_NONE, -1};
+        return UniformHandle{uniforms[index].Location, uniforms[index].Type, index};
+    }
+    // utility uniform functions; each value is shadowed per program and the glUniform
+    // call is skipped when it matches what was last uploaded
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(UniformName name, bool value)
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setInt(name, (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(UniformName name, int value)
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        int loc = update(find(name), &value, sizeof(value));
+        if (loc >= 0)
+            glUniform1i(loc, value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(UniformName name, float value)
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        int loc = update(find(name), &value, sizeof(value));
+        if (loc >= 0)
+            glUniform1f(loc, value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(UniformName name, const glm::vec2 &value)
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        int loc = update(find(name), &value[0], sizeof(value));
+        if (loc >= 0)
+            glUniform2fv(loc, 1, &value[0]);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(UniformName name, float x, float y)
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        setVec2(name, glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(UniformName name, const glm::vec3 &value)
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        int loc = update(find(name), &value[0], sizeof(value));
+        if (loc >= 0)
+            glUniform3fv(loc, 1, &value[0]);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(UniformName name, float x, float y, float z)
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(name, glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(UniformName name, const glm::vec4 &value)
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        int loc = update(find(name), &value[0], sizeof(value));
+        if (loc >= 0)
+            glUniform4fv(loc, 1, &value[0]);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w)
+    void setVec4(UniformName name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        setVec4(name, glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(UniformName name, const glm::mat2 &mat)
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        int loc = update(find(name), &mat[0][0], sizeof(mat));
+        if (loc >= 0)
+            glUniformMatrix2fv(loc, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(UniformName name, const glm::mat3 &mat)
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        int loc = update(find(name), &mat[0][0], sizeof(mat));
+        if (loc >= 0)
+            glUniformMatrix3fv(loc, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(UniformName name, const glm::mat4 &mat)
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        int loc = update(find(name), &mat[0][0], sizeof(mat));
+        if (loc >= 0)
+            glUniformMatrix4fv(loc, 1, GL_FALSE, &mat[0][0]);
     }
+    // handle variants skip the lookup entirely
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle u, bool value) { setInt(u, (int)value); }
+    void setInt(UniformHandle u, int value) { if (update(u.Index, &value, sizeof(value)) >= 0) glUniform1i(u.Location, value); }
+    void setFloat(UniformHandle u, float value) { if (update(u.Index, &value, sizeof(value)) >= 0) glUniform1f(u.Location, value); }
+    void setVec2(UniformHandle u, const glm::vec2 &value) { if (update(u.Index, &value[0], sizeof(value)) >= 0) glUniform2fv(u.Location, 1, &value[0]); }
+    void setVec3(UniformHandle u, const glm::vec3 &value) { if (update(u.Index, &value[0], sizeof(value)) >= 0) glUniform3fv(u.Location, 1, &value[0]); }
+    void setVec4(UniformHandle u, const glm::vec4 &value) { if (update(u.Index, &value[0], sizeof(value)) >= 0) glUniform4fv(u.Location, 1, &value[0]); }
+    void setMat2(UniformHandle u, const glm::mat2 &mat) { if (update(u.Index, &mat[0][0], sizeof(mat)) >= 0) glUniformMatrix2fv(u.Location, 1, GL_FALSE, &mat[0][0]); }
+    void setMat3(UniformHandle u, const glm::mat3 &mat) { if (update(u.Index, &mat[0][0], sizeof(mat)) >= 0) glUniformMatrix3fv(u.Location, 1, GL_FALSE, &mat[0][0]); }
+    void setMat4(UniformHandle u, const glm::mat4 &mat) { if (update(u.Index, &mat[0][0], sizeof(mat)) >= 0) glUniformMatrix4fv(u.Location, 1, GL_FALSE, &mat[0][0]); }
 
 private:
+    struct UniformEntry
+    {
+        unsigned int Hash;
+        int Location;
+        GLenum Type;
+        // last uploaded value, large enough for a mat4
+        bool Shadowed;
+        unsigned char Value[16 * sizeof(float)];
+    };
+    // active uniforms sorted by name hash
+    std::vector<UniformEntry> uniforms;
+    // uniform block bindings requested through bindUniformBlock, re-applied after a swap
+    std::vector<std::pair<std::string, unsigned int> > blockBindings;
+
+    void applyBlockBinding(const char *blockName, unsigned int binding)
+    {
+        GLuint index = glGetUniformBlockIndex(ID, blockName);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+
+    static bool compareHash(const UniformEntry &entry, unsigned int hash)
+    {
+        return entry.Hash < hash;
+    }
+    // index of the uniform in the table, or -1 if the program has no such active uniform
+    int find(UniformName name) const
+    {
+        std::vector<UniformEntry>::const_iterator it = std::lower_bound(uniforms.begin(), uniforms.end(), name.Hash, compareHash);
+        if (it == uniforms.end() || it->Hash != name.Hash)
+            return -1;
+        return (int)(it - uniforms.begin());
+    }
+    // records the value in the shadow copy; returns the location to upload to, or -1 when the
+    // uniform is inactive or already holds exactly these bytes
+    int update(int index, const void *value, size_t size)
+    {
+        if (index < 0)
+            return -1;
+        UniformEntry &entry = uniforms[index];
+        if (entry.Shadowed && std::memcmp(entry.Value, value, size) == 0)
+            return -1;
+        std::memcpy(entry.Value, value, size);
+        entry.Shadowed = true;
+        return entry.Location;
+    }
+    // cache file for a program built from these sources on the current driver, or an empty
+    // string when the driver can't hand out program binaries
+    // ------------------------------------------------------------------------
+    static std::string binaryCachePath(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode)
+    {
+        if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+            return std::string();
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats <= 0)
+            return std::string();
+
+        // the stage sources are separated so moving text between stages changes the key
+        unsigned long long hash = 14695981039346656037ull;
+        const char *parts[] = {
+            vertexCode.c_str(), "\x1f", fragmentCode.c_str(), "\x1f", geometryCode.c_str(), "\x1f",
+            (const char *)glGetString(GL_VENDOR), "\x1f", (const char *)glGetString(GL_RENDERER), "\x1f", (const char *)glGetString(GL_VERSION)
+        };
+        for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++)
+            for (const char *c = parts[i]; c && *c; c++)
+                hash = (hash ^ (unsigned char)*c) * 1099511628211ull;
+
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", hash);
+        SHADER_MKDIR(SHADER_CACHE_DIR);
+        return std::string(SHADER_CACHE_DIR) + "/" + name;
+    }
+    // tries to link the program from a cached binary; fails quietly on a missing or stale file
+    // ------------------------------------------------------------------------
+    static bool loadBinary(unsigned int program, const std::string &cacheFile)
+    {
+        std::ifstream file(cacheFile.c_str(), std::ios::binary);
+        if (!file)
+            return false;
+        GLenum format = 0;
+        file.read((char *)&format, sizeof(format));
+        if (!file)
+            return false;
+        // istreambuf_iterator reads the buffer directly and leaves the stream state alone
+        std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (binary.empty())
+            return false;
+
+        glProgramBinary(program, format, &binary[0], (GLsizei)binary.size());
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        return success != 0;
+    }
+    // ------------------------------------------------------------------------
+    static void saveBinary(unsigned int program, const std::string &cacheFile)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+        std::ofstream file(cacheFile.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file)
+            return;
+        file.write((const char *)&format, sizeof(format));
+        file.write(&binary[0], length);
+    }
+    // queries the linked program for its active uniforms and records their locations by name hash
+    // ------------------------------------------------------------------------
+    void enumerateUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+        uniforms.clear();
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size;
+            GLenum type;
+            GLsizei length;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, &nameBuffer[0]);
+            std::string name(&nameBuffer[0], length);
+            // arrays are reported as "name[0]"; register them under the plain name
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+                name.erase(name.size() - 3);
+            int loc = glGetUniformLocation(ID, name.c_str());
+            // members of uniform blocks have no location
+            if (loc < 0)
+                continue;
+            UniformEntry entry;
+            entry.Hash = uniformHash(name.c_str());
+            entry.Location = loc;
+            entry.Type = type;
+            entry.Shadowed = false;
+            uniforms.push_back(entry);
+        }
+        std::sort(uniforms.begin(), uniforms.end(), [](const UniformEntry &a, const UniformEntry &b) { return a.Hash < b.Hash; });
+        for (size_t i = 1; i < uniforms.size(); i++)
+            if (uniforms[i].Hash == uniforms[i - 1].Hash)
+                std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION at location " << uniforms[i].Location << std::endl;
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -188,6 +577,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
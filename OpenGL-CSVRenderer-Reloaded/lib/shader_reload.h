@@ -0,0 +1,287 @@
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "shader_m.h"
+
+#include <sys/stat.h>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// how often the watched source files are checked for changes, in seconds
+const double SHADER_POLL_INTERVAL = 0.25;
+
+// Watches the source files of registered shaders and rebuilds a program when one of them
+// changes, without stalling the render loop. With KHR/ARB_parallel_shader_compile the
+// driver compiles in the background and update() only polls for completion; otherwise
+// the build runs on a worker thread that owns a hidden context sharing objects with the
+// main one. The new program replaces the old one only after it linked successfully, so a
+// broken edit leaves the last good program on screen.
+class ShaderReloader
+{
+public:
+    bool Parallel;
+
+    // constructor; must be called on the main thread with the render context current
+    ShaderReloader(GLFWwindow *window) : Parallel(false), lastPoll(0.0), swapped(false), sharedWindow(nullptr), stopping(false)
+    {
+#ifdef GLEW_KHR_parallel_shader_compile
+        if (!Parallel && GLEW_KHR_parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+            Parallel = true;
+        }
+#endif
+#ifdef GLEW_ARB_parallel_shader_compile
+        if (!Parallel && GLEW_ARB_parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+            Parallel = true;
+        }
+#endif
+        if (Parallel)
+            return;
+
+        // hidden 1x1 window whose context shares programs with the render context;
+        // the context hints given for the main window are still in effect
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        sharedWindow = glfwCreateWindow(1, 1, "", NULL, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (sharedWindow == NULL)
+        {
+            std::cout << "ERROR::SHADER_RELOAD::SHARED_CONTEXT_FAILED, rebuilding on the render thread" << std::endl;
+            return;
+        }
+        worker = std::thread(&ShaderReloader::workerLoop, this);
+    }
+    ~ShaderReloader()
+    {
+        if (worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            worker.join();
+        }
+        if (sharedWindow)
+            glfwDestroyWindow(sharedWindow);
+        for (size_t i = 0; i < pending.size(); i++)
+            glDeleteProgram(pending[i].Build.Program);
+        for (size_t i = 0; i < finished.size(); i++)
+            glDeleteProgram(finished[i].Program);
+    }
+
+    // starts watching the source files of a shader; the shader must outlive the reloader
+    void watch(Shader *shader)
+    {
+        Watched w;
+        w.Target = shader;
+        w.Stamp = stamp(shader);
+        w.Busy = false;
+        watched.push_back(w);
+    }
+
+    // call once per frame on the render thread; starts rebuilds for changed files and swaps
+    // in programs that finished linking. Returns true if a program was replaced.
+    bool update()
+    {
+        swapped = false;
+        double now = glfwGetTime();
+        if (now - lastPoll >= SHADER_POLL_INTERVAL)
+        {
+            lastPoll = now;
+            for (size_t i = 0; i < watched.size(); i++)
+            {
+                time_t s = stamp(watched[i].Target);
+                if (s == watched[i].Stamp || watched[i].Busy)
+                    continue;
+                watched[i].Stamp = s;
+                startRebuild(i);
+            }
+        }
+        collectParallel();
+        collectWorker();
+        return swapped;
+    }
+
+private:
+    struct Watched
+    {
+        Shader *Target;
+        time_t Stamp;   // newest modification time of the shader's files
+        bool Busy;      // a rebuild is in flight
+    };
+    // a rebuild compiling in the driver's background threads
+    struct ParallelJob
+    {
+        size_t Index;
+        ProgramBuild Build;
+    };
+    // a rebuild handed to the worker thread
+    struct WorkerJob
+    {
+        size_t Index;
+        std::string Vertex, Fragment, Geometry;
+        unsigned int Program;
+        bool Linked;
+    };
+
+    std::vector<Watched> watched;
+    std::vector<ParallelJob> pending;
+    double lastPoll;
+    bool swapped;
+
+    GLFWwindow *sharedWindow;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<WorkerJob> queued;
+    std::deque<WorkerJob> finished;
+    bool stopping;
+
+    static time_t fileTime(const std::string &path)
+    {
+        struct stat info;
+        if (path.empty() || stat(path.c_str(), &info) != 0)
+            return 0;
+        return info.st_mtime;
+    }
+    static time_t stamp(const Shader *shader)
+    {
+        time_t t = fileTime(shader->VertexPath);
+        time_t f = fileTime(shader->FragmentPath);
+        time_t g = fileTime(shader->GeometryPath);
+        if (f > t)
+            t = f;
+        if (g > t)
+            t = g;
+        for (size_t i = 0; i < shader->IncludedPaths.size(); i++)
+        {
+            time_t n = fileTime(shader->IncludedPaths[i]);
+            if (n > t)
+                t = n;
+        }
+        return t;
+    }
+
+    void startRebuild(size_t index)
+    {
+        Shader *shader = watched[index].Target;
+        std::string v, f, g;
+        if (!shader->readSources(v, f, g))
+            return;
+        std::cout << "Reloading " << shader->VertexPath << " / " << shader->FragmentPath << std::endl;
+        watched[index].Busy = true;
+
+        if (Parallel)
+        {
+            ParallelJob job;
+            job.Index = index;
+            job.Build = Shader::beginBuild(v, f, g);
+            pending.push_back(job);
+        }
+        else if (worker.joinable())
+        {
+            WorkerJob job;
+            job.Index = index;
+            job.Vertex = v;
+            job.Fragment = f;
+            job.Geometry = g;
+            job.Program = 0;
+            job.Linked = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queued.push_back(job);
+            }
+            wake.notify_one();
+        }
+        else
+        {
+            // no background path available; build synchronously
+            ProgramBuild b = Shader::beginBuild(v, f, g);
+            finish(index, b.Program, Shader::finishBuild(b));
+        }
+    }
+
+    void collectParallel()
+    {
+        for (size_t i = 0; i < pending.size();)
+        {
+            GLint done = GL_TRUE;
+            if (!pending[i].Build.FromCache)
+                glGetProgramiv(pending[i].Build.Program, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+            {
+                i++;
+                continue;
+            }
+            finish(pending[i].Index, pending[i].Build.Program, Shader::finishBuild(pending[i].Build));
+            pending.erase(pending.begin() + i);
+        }
+    }
+
+    void collectWorker()
+    {
+        std::deque<WorkerJob> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.swap(finished);
+        }
+        for (size_t i = 0; i < done.size(); i++)
+            finish(done[i].Index, done[i].Program, done[i].Linked);
+    }
+
+    void finish(size_t index, unsigned int program, bool linked)
+    {
+        watched[index].Busy = false;
+        if (linked)
+        {
+            watched[index].Target->swapProgram(program);
+            swapped = true;
+        }
+        else
+            glDeleteProgram(program);
+    }
+
+    void workerLoop()
+    {
+        glfwMakeContextCurrent(sharedWindow);
+        for (;;)
+        {
+            WorkerJob job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queued.empty(); });
+                if (stopping)
+                    break;
+                job = queued.front();
+                queued.pop_front();
+            }
+            ProgramBuild b = Shader::beginBuild(job.Vertex, job.Fragment, job.Geometry);
+            job.Linked = Shader::finishBuild(b);
+            job.Program = b.Program;
+            // make sure the program is complete before the render context picks it up
+            glFinish();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.push_back(job);
+            }
+        }
+        glfwMakeContextCurrent(NULL);
+    }
+};
+#endif
@@ -0,0 +1,77 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include "shader_m.h"
+#include "shader_reload.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+
+// A family of programs built from the same sources with different feature #defines.
+// Each feature is one bit of the variant mask; variant(mask) compiles that combination
+// the first time it is asked for and returns the cached program afterwards, so features
+// are resolved at compile time instead of branching on uniforms per fragment.
+class ShaderVariants
+{
+public:
+    // constructor only records the sources; variants are built on demand
+    ShaderVariants(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &features, const char* geometryPath = nullptr) : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath ? geometryPath : ""), features(features), reloader(nullptr)
+    {
+    }
+    ~ShaderVariants()
+    {
+        for (std::map<unsigned int, Shader *>::iterator it = variants.begin(); it != variants.end(); ++it)
+        {
+            glState().forgetProgram(it->second->ID);
+            glDeleteProgram(it->second->ID);
+            delete it->second;
+        }
+    }
+
+    // returns the program for a combination of feature bits, building it if needed
+    Shader &variant(unsigned int mask)
+    {
+        std::map<unsigned int, Shader *>::iterator it = variants.find(mask);
+        if (it != variants.end())
+            return *it->second;
+
+        std::string defines;
+        for (size_t i = 0; i < features.size(); i++)
+            if (mask & (1u << i))
+                defines += "#define " + features[i] + "\n";
+        Shader *shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), geometryPath.empty() ? nullptr : geometryPath.c_str(), defines);
+        for (size_t i = 0; i < blockBindings.size(); i++)
+            shader->bindUniformBlock(blockBindings[i].first.c_str(), blockBindings[i].second);
+        if (reloader)
+            reloader->watch(shader);
+        variants[mask] = shader;
+        return *shader;
+    }
+
+    // applies to every variant, including the ones built later
+    void bindUniformBlock(const char *blockName, unsigned int binding)
+    {
+        blockBindings.push_back(std::make_pair(std::string(blockName), binding));
+        for (std::map<unsigned int, Shader *>::iterator it = variants.begin(); it != variants.end(); ++it)
+            it->second->bindUniformBlock(blockName, binding);
+    }
+    // hot reloads every variant, including the ones built later; the reloader must outlive this object
+    void watch(ShaderReloader *shaderReloader)
+    {
+        reloader = shaderReloader;
+        for (std::map<unsigned int, Shader *>::iterator it = variants.begin(); it != variants.end(); ++it)
+            reloader->watch(it->second);
+    }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::string geometryPath;
+    std::vector<std::string> features;
+    std::map<unsigned int, Shader *> variants;
+    std::vector<std::pair<std::string, unsigned int> > blockBindings;
+    ShaderReloader *reloader;
+};
+#endif
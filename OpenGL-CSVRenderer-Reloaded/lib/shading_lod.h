@@ -0,0 +1,39 @@
+#ifndef SHADING_LOD_H
+#define SHADING_LOD_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+
+#include <cfloat>
+
+// Per-object choice between per-pixel and per-vertex lighting. Objects whose projected
+// bounding sphere is larger than the threshold get Phong; small or distant ones get Gouraud,
+// whose fragment shader only interpolates a color. Both programs include shader/lighting.glsl
+// so the switch does not change the lighting model, only where it is evaluated.
+enum ShadingModel
+{
+    SHADING_PHONG,
+    SHADING_GOURAUD
+};
+
+// Default screen radius, in pixels, below which an object is Gouraud shaded
+const float SHADING_LOD_THRESHOLD = 64.0f;
+
+// approximate radius in pixels of a world space sphere seen through a perspective projection;
+// FLT_MAX when the camera is inside the sphere
+inline float projectedRadius(const BoundingSphere &sphere, const glm::vec3 &cameraPos, const glm::mat4 &projection, float viewportHeight)
+{
+    float distance = glm::length(sphere.Center - cameraPos);
+    if (distance <= sphere.Radius)
+        return FLT_MAX;
+    // projection[1][1] is cot(fovy / 2)
+    return sphere.Radius * projection[1][1] * 0.5f * viewportHeight / distance;
+}
+
+// shading model for an object whose projected radius is 'pixels'
+inline ShadingModel selectShading(float pixels, float threshold = SHADING_LOD_THRESHOLD)
+{
+    return pixels >= threshold ? SHADING_PHONG : SHADING_GOURAUD;
+}
+#endif
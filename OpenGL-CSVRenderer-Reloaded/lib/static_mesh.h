@@ -0,0 +1,130 @@
+#ifndef STATIC_MESH_H
+#define STATIC_MESH_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "gl_state.h"
+
+#include <vector>
+#include <cstddef>
+
+// floats per vertex: position, normal, color, texture coordinate
+const int MESH_VERTEX_FLOATS = 11;
+
+// All meshes that never move, packed into one immutable vertex buffer behind a single VAO.
+// Meshes are pre-transformed to world space when added, so any subset of them can be drawn
+// with one multi-draw call as long as they share program and texture. The positions
+// are also kept as a separate tightly packed stream (DepthVAO) for the depth pre-pass, which
+// then fetches 12 instead of 44 bytes per vertex; vertex indices are the same in both.
+class StaticMeshBuffer
+{
+public:
+    // range of vertices a mesh occupies in the buffer
+    struct Mesh
+    {
+        GLint First;
+        GLsizei Count;
+    };
+
+    unsigned int VAO;
+    unsigned int VBO;
+    unsigned int DepthVAO;
+    unsigned int PositionVBO;
+    std::vector<Mesh> Meshes;
+
+    StaticMeshBuffer() : VAO(0), VBO(0), DepthVAO(0), PositionVBO(0)
+    {
+    }
+    ~StaticMeshBuffer()
+    {
+        if (VAO)
+        {
+            glState().forgetVertexArray(VAO);
+            glDeleteVertexArrays(1, &VAO);
+        }
+        if (VBO)
+            glDeleteBuffers(1, &VBO);
+        if (DepthVAO)
+        {
+            glState().forgetVertexArray(DepthVAO);
+            glDeleteVertexArrays(1, &DepthVAO);
+        }
+        if (PositionVBO)
+            glDeleteBuffers(1, &PositionVBO);
+    }
+
+    // appends 'count' vertices transformed by 'model' (normals by 'normalMatrix') and returns
+    // the mesh index; only valid before finish()
+    unsigned int add(const float *vertexes, int count, const glm::mat4 &model, const glm::mat3 &normalMatrix)
+    {
+        Mesh mesh;
+        mesh.First = (GLint)(vertices.size() / MESH_VERTEX_FLOATS);
+        mesh.Count = count;
+        Meshes.push_back(mesh);
+
+        for (int i = 0; i < count; i++)
+        {
+            const float *v = vertexes + i * MESH_VERTEX_FLOATS;
+            glm::vec3 position = glm::vec3(model * glm::vec4(v[0], v[1], v[2], 1.0f));
+            glm::vec3 normal = normalMatrix * glm::vec3(v[3], v[4], v[5]);
+            vertices.push_back(position.x);
+            vertices.push_back(position.y);
+            vertices.push_back(position.z);
+            vertices.push_back(normal.x);
+            vertices.push_back(normal.y);
+            vertices.push_back(normal.z);
+            vertices.insert(vertices.end(), v + 6, v + MESH_VERTEX_FLOATS);
+        }
+        return (unsigned int)Meshes.size() - 1;
+    }
+
+    // uploads everything added so far into an immutable buffer and sets up the VAO; the CPU copy is released
+    void finish()
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+
+        glState().bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLsizeiptr size = (GLsizeiptr)(vertices.size() * sizeof(float));
+        if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+            glBufferStorage(GL_ARRAY_BUFFER, size, vertices.data(), 0);
+        else
+            glBufferData(GL_ARRAY_BUFFER, size, vertices.data(), GL_STATIC_DRAW);
+
+        GLsizei stride = MESH_VERTEX_FLOATS * sizeof(float);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void *)(9 * sizeof(float)));
+        glEnableVertexAttribArray(3);
+
+        // position-only stream for the depth pre-pass
+        size_t vertexCount = vertices.size() / MESH_VERTEX_FLOATS;
+        std::vector<float> positions(vertexCount * 3);
+        for (size_t i = 0; i < vertexCount; i++)
+            for (int c = 0; c < 3; c++)
+                positions[i * 3 + c] = vertices[i * MESH_VERTEX_FLOATS + c];
+        glGenVertexArrays(1, &DepthVAO);
+        glGenBuffers(1, &PositionVBO);
+        glState().bindVertexArray(DepthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, PositionVBO);
+        size = (GLsizeiptr)(positions.size() * sizeof(float));
+        if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+            glBufferStorage(GL_ARRAY_BUFFER, size, positions.data(), 0);
+        else
+            glBufferData(GL_ARRAY_BUFFER, size, positions.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
+
+        std::vector<float>().swap(vertices);
+    }
+
+private:
+    std::vector<float> vertices;
+};
+#endif
@@ -0,0 +1,131 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <GL/glew.h>
+
+#include <cstring>
+#include <iostream>
+
+// Default ring values
+const unsigned int UPLOAD_SLOTS      = 3;
+const unsigned int UPLOAD_SLOT_BYTES = 4 * 1024 * 1024;
+
+// Streams texture pixels to the GPU through a ring of pixel buffer objects so glTexImage2D
+// returns immediately and the driver copies the pixels asynchronously. When GL 4.4 or
+// ARB_buffer_storage is available the whole ring is a single persistently mapped buffer,
+// otherwise each slot is orphaned and mapped on demand.
+class TextureUploader
+{
+public:
+    // ring attributes
+    unsigned int PBO;
+    unsigned int SlotCount;
+    unsigned int SlotSize;
+    bool Persistent;
+
+    // constructor creates the ring; needs a current GL context
+    TextureUploader(unsigned int slotCount = UPLOAD_SLOTS, unsigned int slotSize = UPLOAD_SLOT_BYTES) : PBO(0), SlotCount(slotCount), SlotSize(slotSize), Persistent(false), current(0), mapped(nullptr)
+    {
+        fences = new GLsync[SlotCount];
+        for (unsigned int i = 0; i < SlotCount; i++)
+            fences[i] = 0;
+
+        glGenBuffers(1, &PBO);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)SlotSize * SlotCount, NULL, flags);
+            mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)SlotSize * SlotCount, flags);
+            Persistent = mapped != nullptr;
+        }
+        else
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)SlotSize * SlotCount, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    ~TextureUploader()
+    {
+        for (unsigned int i = 0; i < SlotCount; i++)
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        delete[] fences;
+        if (Persistent)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &PBO);
+    }
+
+    // returns writable memory for the next upload of 'size' bytes, or nullptr when the image
+    // does not fit in a slot; the caller fills it and then calls upload()
+    unsigned char *reserve(unsigned int size)
+    {
+        if (size > SlotSize)
+            return nullptr;
+
+        current = (current + 1) % SlotCount;
+        waitSlot(current);
+
+        GLintptr offset = (GLintptr)current * SlotSize;
+        if (Persistent)
+            return mapped + offset;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        unsigned char *ptr = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return ptr;
+    }
+
+    // sources the currently bound GL_TEXTURE_2D from the slot handed out by the last reserve()
+    void upload(int width, int height, GLenum format = GL_RGBA)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        if (!Persistent)
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, (void *)((GLintptr)current * SlotSize));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // convenience wrapper for pixels that already live in client memory; falls back to a
+    // direct upload when the image is larger than a slot
+    void upload(const unsigned char *pixels, int width, int height, int channels = 4)
+    {
+        GLenum format = channels == 3 ? GL_RGB : GL_RGBA;
+        unsigned int size = (unsigned int)width * height * channels;
+        unsigned char *dst = reserve(size);
+        if (dst == nullptr)
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+            return;
+        }
+        std::memcpy(dst, pixels, size);
+        upload(width, height, format);
+    }
+
+private:
+    unsigned int current;
+    unsigned char *mapped;
+    GLsync *fences;
+
+    // blocks until the GPU has consumed the previous upload that used this slot
+    void waitSlot(unsigned int slot)
+    {
+        if (!fences[slot])
+            return;
+        GLenum status = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        if (status == GL_WAIT_FAILED)
+            std::cout << "ERROR::TEXTURE_UPLOAD::FENCE_WAIT_FAILED" << std::endl;
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+    }
+};
+#endif
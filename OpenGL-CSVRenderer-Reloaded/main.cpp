@@ -6,11 +6,34 @@
 #include "stb_image.h"
 #include "lib/shader_m.h"
 #include "lib/camera.h"
+#include "lib/texture_upload.h"
+#include "lib/frame_uniforms.h"
+#include "lib/shader_reload.h"
+#include "lib/shader_variants.h"
+#include "lib/normal_matrix.h"
+#include "lib/shading_lod.h"
+#include "lib/bounds.h"
+#include "lib/frustum.h"
+#include "lib/bounds_soa.h"
+#include "lib/gl_state.h"
+#include "lib/static_mesh.h"
+#include "lib/indirect_draw.h"
+#include "lib/instancing.h"
+#include "lib/render_queue.h"
+#include "lib/material.h"
+#include "lib/job_pool.h"
+#include "lib/frame_pacer.h"
+#include "lib/gpu_timer.h"
+#include "lib/render_graph.h"
+#include "lib/quality_governor.h"
 #include <iostream>
+#include <algorithm>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
+void refresh_callback(GLFWwindow *window);
 void processInput(GLFWwindow *window);
 
 // settings
@@ -33,6 +56,31 @@ glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 // Reflexo especular
 float specularStrength = 0.5;
 
+// render on demand: when enabled (key R) a frame is only drawn after something changed and the
+// loop otherwise sleeps in glfwWaitEventsTimeout. The orbiting light (key P) counts as a change.
+bool renderOnDemand = false;
+bool animateLight = true;
+bool frameDirty = true;
+
+// depth pre-pass (key Z): opaque geometry is drawn depth-only first, so the lighting
+// shaders run once per visible pixel
+bool depthPrepass = false;
+
+// low-latency mode (key F): at most one frame in flight instead of FRAMES_IN_FLIGHT
+bool lowLatency = false;
+
+// adaptive quality (key G): lowers the render resolution and the shading detail while the frame
+// time misses the target, and raises them again once there is headroom
+bool adaptiveQuality = true;
+
+// objects smaller than this on screen, in pixels, are lit per vertex
+float shadingLodThreshold = SHADING_LOD_THRESHOLD;
+
+// lighting program feature bits, see ShaderVariants
+const unsigned int VARIANT_TEXTURED = 1 << 0;
+const unsigned int VARIANT_INSTANCED = 1 << 1;
+const unsigned int VARIANT_ALPHA_TEST = 1 << 2;
+
 typedef struct
 {
     unsigned int VAO;
@@ -41,9 +89,34 @@ typedef struct
     float *vertexes;
     int pointsCount;
     bool loadedTexture;
+    MaterialClass material; // from the texture's alpha channel
+    BoundingSphere bounds;  // object space, for the shading level of detail and culling
+    AABB box;               // object space, for culling
+    unsigned int mesh;      // index in the StaticMeshBuffer, for objects without their own VAO
 
 } RenderableObj;
 
+// one placement of a repeated prop; all placements of the same file share one mesh
+typedef struct
+{
+    std::string file;
+    glm::vec3 position;
+    float scale;
+    glm::vec3 tint;
+
+} PropPlacement;
+
+// a prop file loaded once and drawn for all its placements with one instanced draw
+typedef struct
+{
+    std::string file;
+    RenderableObj obj;
+    InstancedMesh *instances;
+    size_t firstBounds;                 // its placements' entries in the scene bounds
+    std::vector<unsigned int> visible;  // culling output, one slot per placement
+
+} PropSet;
+
 std::pair<std::string, std::vector<float>> read_csv(std::string filename)
 {
     std::vector<float> resultVector;
@@ -85,7 +158,16 @@ std::pair<std::string, std::vector<float>> read_csv(std::string filename)
     return std::make_pair(texture, resultVector);
 }
 
-RenderableObj load_renderableObj(std::string file)
+// feature bits of the lighting program an object needs
+unsigned int materialVariant(const RenderableObj &obj)
+{
+    if (!obj.loadedTexture)
+        return 0;
+    return obj.material == MATERIAL_ALPHA_TESTED ? VARIANT_TEXTURED | VARIANT_ALPHA_TEST : VARIANT_TEXTURED;
+}
+
+// ownBuffers = false skips the VAO/VBO for meshes that are packed into a StaticMeshBuffer
+RenderableObj load_renderableObj(std::string file, TextureUploader &uploader, bool ownBuffers = true)
 {
     RenderableObj obj;
 
@@ -101,35 +183,36 @@ RenderableObj load_renderableObj(std::string file)
     }
     std::cout << vectorSize / 11 << std::endl;
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    unsigned int VBO, objVAO;
-    glGenVertexArrays(1, &objVAO);
-    glGenBuffers(1, &VBO);
+    unsigned int VBO = 0, objVAO = 0;
+    if (ownBuffers)
+    {
+        glGenVertexArrays(1, &objVAO);
+        glGenBuffers(1, &VBO);
 
-    glBindVertexArray(objVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vectorSize, vertices, GL_STATIC_DRAW);
+        glState().bindVertexArray(objVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vectorSize, vertices, GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(0);
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void *)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
 
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void *)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void *)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
 
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void *)(9 * sizeof(float)));
-    glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void *)(9 * sizeof(float)));
+        glEnableVertexAttribArray(3);
+    }
 
     if (textureIMG != "")
     {
         obj.loadedTexture =true;
+        obj.material = MATERIAL_OPAQUE;
         unsigned int texture;
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        glState().bindTexture(texture);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -141,10 +224,12 @@ RenderableObj load_renderableObj(std::string file)
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
         std::string tmp = "textures/" + textureIMG;
-        unsigned char *data = stbi_load(tmp.c_str(), &width, &height, &nrChannels, 0);
+        // always expand to RGBA so the pixels match the GL_RGBA upload and the PBO slot size
+        unsigned char *data = stbi_load(tmp.c_str(), &width, &height, &nrChannels, STBI_rgb_alpha);
         if (data)
         {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            obj.material = classifyAlpha(data, width, height);
+            uploader.upload(data, width, height);
             glGenerateMipmap(GL_TEXTURE_2D);
         }
         else
@@ -155,12 +240,19 @@ RenderableObj load_renderableObj(std::string file)
         obj.texture = texture;
     }
     else
+    {
         obj.loadedTexture = false;
+        obj.material = MATERIAL_OPAQUE;
+        obj.texture = 0;
+    }
 
     obj.pointsCount = vectorSize / 11;
+    obj.bounds = computeBoundingSphere(vertices, obj.pointsCount, 11);
+    obj.box = computeAABB(vertices, obj.pointsCount, 11);
     obj.vertexes = vertices;
     obj.VAO = objVAO;
     obj.VBO = VBO;
+    obj.mesh = 0;
 
     return obj;
 }
@@ -191,6 +283,8 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetWindowRefreshCallback(window, refresh_callback);
 
     // tell GLFW to capture our mouse
     //glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -209,12 +303,41 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    glState().enable(GL_DEPTH_TEST);
+    // blending is only enabled by the render queue for the blended pass
 
     // build and compile our shader zprogram
     // ------------------------------------
-    Shader lightingShader("shader/phong_lighting.vs", "shader/phong_lighting.fs");
+    // one program set per shading model, indexed by ShadingModel
+    ShaderVariants *lightingShaders[2];
+    lightingShaders[SHADING_PHONG] = new ShaderVariants("shader/phong_lighting.vs", "shader/phong_lighting.fs", {"TEXTURED", "INSTANCED", "ALPHA_TEST"});
+    lightingShaders[SHADING_GOURAUD] = new ShaderVariants("shader/gouraud_lighting.vs", "shader/gouraud_lighting.fs", {"TEXTURED", "INSTANCED", "ALPHA_TEST"});
     Shader lightCubeShader("shader/light_cube.vs", "shader/light_cube.fs");
+    ShaderVariants *depthShaders = new ShaderVariants("shader/depth_prepass.vs", "shader/depth_prepass.fs", {"INSTANCED"});
+    depthShaders->bindUniformBlock(FRAME_UNIFORM_BLOCK, FRAME_UNIFORM_BINDING);
+    depthShaders->bindUniformBlock(OBJECT_UNIFORM_BLOCK, OBJECT_UNIFORM_BINDING);
+    lightCubeShader.bindUniformBlock(FRAME_UNIFORM_BLOCK, FRAME_UNIFORM_BINDING);
+    // build the variants the scene uses up front so none compiles mid-frame; the frame
+    // preparation jobs pick programs from this table and never touch ShaderVariants
+    Shader *lightingPrograms[2][8];
+    for (int s = 0; s < 2; s++)
+    {
+        lightingShaders[s]->bindUniformBlock(FRAME_UNIFORM_BLOCK, FRAME_UNIFORM_BINDING);
+        lightingShaders[s]->bindUniformBlock(OBJECT_UNIFORM_BLOCK, OBJECT_UNIFORM_BINDING);
+        for (unsigned int mask = 0; mask < 8; mask++)
+        {
+            lightingPrograms[s][mask] = nullptr;
+            if (!(mask & VARIANT_ALPHA_TEST) || (mask & VARIANT_TEXTURED))
+                lightingPrograms[s][mask] = &lightingShaders[s]->variant(mask);
+        }
+    }
+
+    // rebuild the programs in the background whenever their source files change
+    ShaderReloader *shaderReloader = new ShaderReloader(window);
+    lightingShaders[SHADING_PHONG]->watch(shaderReloader);
+    lightingShaders[SHADING_GOURAUD]->watch(shaderReloader);
+    shaderReloader->watch(&lightCubeShader);
+    depthShaders->watch(shaderReloader);
 
     std::string models[] =
     {
@@ -225,24 +348,145 @@ int main()
         "janela_d.csv",
         "janela_e.csv",
         "chamine.csv",
-        "caule.csv",
-        "copa.csv",
         "cerca.csv"
     };
 
+    // the tree is drawn through the instancing path, so more copies only need more entries
+    // here; each tree is a trunk and a crown placed with the same transform
+    PropPlacement placements[] =
+    {
+        { "caule.csv", glm::vec3(0.0f), 1.0f, glm::vec3(1.0f) },
+        { "copa.csv",  glm::vec3(0.0f), 1.0f, glm::vec3(1.0f) }
+    };
+
+    // texture pixels are streamed through a PBO ring instead of blocking in glTexImage2D
+    TextureUploader *textureUploader = new TextureUploader();
+
     int modelscount = sizeof(models) / sizeof(models[0]);
     RenderableObj *objects = new RenderableObj[modelscount];
 
     for (int i = 0; i < modelscount; i++)
     {
-        objects[i] = load_renderableObj("csv/"+models[i]);
+        objects[i] = load_renderableObj("csv/"+models[i], *textureUploader, false);
+    }
+    RenderableObj sun = load_renderableObj("csv/sun.csv", *textureUploader);
+
+    // object transforms; the scene is static, so the normal matrices are computed once
+    glm::mat4 *modelMatrices = new glm::mat4[modelscount];
+    glm::mat3 *normalMatrices = new glm::mat3[modelscount];
+    for (int i = 0; i < modelscount; i++)
+        modelMatrices[i] = glm::mat4(1.0f);
+    computeNormalMatrices(modelMatrices, normalMatrices, modelscount);
+
+    // the scene meshes share one vertex buffer and VAO, already in world space, and are
+    // drawn with one glMultiDrawArrays per program and texture
+    StaticMeshBuffer *staticMeshes = new StaticMeshBuffer();
+    for (int i = 0; i < modelscount; i++)
+        objects[i].mesh = staticMeshes->add(objects[i].vertexes, objects[i].pointsCount, modelMatrices[i], normalMatrices[i]);
+
+    // repeated props stay in object space in the same buffer; their placements live in
+    // per-instance attributes
+    std::vector<PropSet> props;
+    int placementcount = sizeof(placements) / sizeof(placements[0]);
+    for (int i = 0; i < placementcount; i++)
+    {
+        bool loaded = false;
+        for (size_t p = 0; p < props.size() && !loaded; p++)
+            loaded = props[p].file == placements[i].file;
+        if (loaded)
+            continue;
+        PropSet prop;
+        prop.file = placements[i].file;
+        prop.obj = load_renderableObj("csv/" + prop.file, *textureUploader, false);
+        prop.obj.mesh = staticMeshes->add(prop.obj.vertexes, prop.obj.pointsCount, glm::mat4(1.0f), glm::mat3(1.0f));
+        prop.instances = nullptr;
+        props.push_back(prop);
+    }
+    staticMeshes->finish();
+    for (size_t p = 0; p < props.size(); p++)
+    {
+        props[p].instances = new InstancedMesh(*staticMeshes, props[p].obj.mesh);
+        for (int i = 0; i < placementcount; i++)
+        {
+            if (placements[i].file != props[p].file)
+                continue;
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), placements[i].position);
+            model = glm::scale(model, glm::vec3(placements[i].scale));
+            props[p].instances->add(model, placements[i].tint);
+        }
+        props[p].instances->upload();
+    }
+
+    // world space bounds of everything that is culled: the scene objects, then the placements
+    // of each prop set. The scene is static, so they are computed once; every frame they are
+    // tested against the frustum in SIMD batches that emit compact lists of visible indices.
+    BoundsSoA *sceneBounds = new BoundsSoA();
+    for (int i = 0; i < modelscount; i++)
+        sceneBounds->add(transformAABB(objects[i].box, modelMatrices[i]));
+    for (size_t p = 0; p < props.size(); p++)
+    {
+        props[p].firstBounds = sceneBounds->size();
+        for (size_t i = 0; i < props[p].instances->Transforms.size(); i++)
+            sceneBounds->add(transformSphere(props[p].obj.bounds, props[p].instances->Transforms[i]));
+        props[p].visible.resize(props[p].instances->Transforms.size());
+    }
+    std::vector<unsigned int> visibleObjects(modelscount);
+    std::vector<unsigned char> objectVisible(modelscount);
+    std::cout << "Frustum culling: " << BoundsSoA::cullPathName() << std::endl;
+    // per-frame data is written into a ring of persistently mapped regions, one per frame in
+    // flight, so uploading it never waits for the GPU. A region holds the FrameData block and
+    // at most one ObjectData block per draw, each starting on a uniform offset boundary, which
+    // is at most 256 bytes in practice.
+    FrameRingBuffer *frameRing = new FrameRingBuffer(GL_UNIFORM_BUFFER, (GLsizeiptr)(modelscount + props.size() + 1) * 256);
+    // camera and light uniforms shared by all programs, uploaded once per frame
+    FrameUniformBuffer *frameUniforms = new FrameUniformBuffer(*frameRing);
+
+    // every draw of the frame goes through here and is sorted by program, texture, VAO and depth
+    RenderQueue *renderQueue = new RenderQueue(100.0f);
+    renderQueue->TransformRing = frameRing;
+    renderQueue->DepthProgram = &depthShaders->variant(0);
+    renderQueue->DepthInstancedProgram = &depthShaders->variant(1);
+    // the static meshes are already in world space
+    const glm::mat4 identityModel(1.0f);
+    const glm::mat3 identityNormal(1.0f);
+    // the queue is filled from several threads, so all the state it sorts by is known up front
+    for (int s = 0; s < 2; s++)
+        for (unsigned int mask = 0; mask < 8; mask++)
+            if (lightingPrograms[s][mask])
+                renderQueue->registerProgram(lightingPrograms[s][mask]);
+    renderQueue->registerVAO(staticMeshes->VAO);
+    for (int i = 0; i < modelscount; i++)
+        renderQueue->registerTexture(objects[i].texture);
+    for (size_t p = 0; p < props.size(); p++)
+    {
+        renderQueue->registerTexture(props[p].obj.texture);
+        renderQueue->registerVAO(props[p].instances->VAO);
     }
-    RenderableObj sun = load_renderableObj("csv/sun.csv");
+
+    // frame preparation (LOD selection, packets, sort keys) runs on these threads; only the
+    // submission of the finished queue happens on the context thread
+    JobPool *jobPool = new JobPool();
+    std::cout << "Frame preparation threads: " << jobPool->Workers + 1 << std::endl;
+
+    // keeps the CPU at most a fixed number of frames ahead of the GPU
+    FramePacer *framePacer = new FramePacer(FRAMES_IN_FLIGHT);
+
+    // frame time measurements and the quality level they drive
+    QualityGovernor *qualityGovernor = new QualityGovernor(QUALITY_TARGET_MS);
+    GpuTimer *gpuTimer = new GpuTimer();
+
+    // the passes of a frame and the offscreen targets between them, rebuilt every frame
+    RenderGraph *renderGraph = new RenderGraph();
+    renderGraph->ClearColor = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
 
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
     {
+        // wait until the GPU is close enough behind, before input is sampled
+        framePacer->MaxFramesInFlight = lowLatency ? 1 : FRAMES_IN_FLIGHT;
+        framePacer->beginFrame();
+
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
@@ -250,64 +494,238 @@ int main()
         lastFrame = currentFrame;
 
         processInput(window);
+        if (shaderReloader->update())
+            frameDirty = true;
+        if (animateLight)
+            frameDirty = true;
 
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-
-        lightPos.x = cos(glfwGetTime()) * 2.5f;
-        lightPos.y = sin(glfwGetTime()) * 5.0f;
-        lightPos.z = cos(glfwGetTime()) * 5.0f;
-
-
-        lightingShader.use();
-        lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-        lightingShader.setVec3("lightPos", lightPos);
-        lightingShader.setVec3("viewPos", camera.Position);
-        lightingShader.setFloat("specularStrength", specularStrength);
-
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
-
+        if (renderOnDemand && !frameDirty)
+        {
+            // nothing to redraw; sleep until an event arrives, waking up in time for the next
+            // shader file poll
+            glfwWaitEventsTimeout(SHADER_POLL_INTERVAL);
+            // idle time must not count as movement time on the next frame
+            lastFrame = glfwGetTime();
+            continue;
+        }
+        frameDirty = false;
+        double cpuStart = glfwGetTime();
+
+        // quality level for this frame
+        // ----------------------------
+        qualityGovernor->Enabled = adaptiveQuality;
+        const QualityLevel &quality = qualityGovernor->current();
+        int screenWidth, screenHeight;
+        glfwGetFramebufferSize(window, &screenWidth, &screenHeight);
+        bool scaled = quality.ResolutionScale < 1.0f && screenWidth > 0 && screenHeight > 0;
+        int renderWidth = scaled ? (int)(screenWidth * quality.ResolutionScale) : screenWidth;
+        int renderHeight = scaled ? (int)(screenHeight * quality.ResolutionScale) : screenHeight;
+        // a larger threshold lights more objects per vertex; forcing Gouraud lights all of them so
+        float lodThreshold = quality.ForceGouraud ? 1e30f : shadingLodThreshold * quality.LodBias;
+
+        if (animateLight)
+        {
+            lightPos.x = cos(glfwGetTime()) * 2.5f;
+            lightPos.y = sin(glfwGetTime()) * 5.0f;
+            lightPos.z = cos(glfwGetTime()) * 5.0f;
+        }
 
-        glm::mat4 model = glm::mat4(1.0f);
-        lightingShader.setMat4("model", model);
 
-        for (int i = 0; i < modelscount; i++)
+        frameRing->beginFrame();
+        frameUniforms->Data.Projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        frameUniforms->Data.View = camera.GetViewMatrix();
+        frameUniforms->Data.ViewPos = camera.Position;
+        frameUniforms->Data.LightPos = lightPos;
+        frameUniforms->Data.LightColor = glm::vec3(1.0f, 1.0f, 1.0f);
+        frameUniforms->Data.SpecularStrength = specularStrength;
+        frameUniforms->upload();
+
+        // preparation: one queue slot per scene object and per prop set; every job writes its
+        // own slots and only reads the scene, the camera and the program table. Slots are
+        // stable across frames: objects outside the view frustum hide theirs, so only their
+        // own indirect command changes.
+        // --------------------------------------------------------------------------------------
+        const glm::mat4 projection = frameUniforms->Data.Projection;
+        const glm::vec3 viewPos = camera.Position;
+        const Frustum frustum(projection * frameUniforms->Data.View);
+        size_t drawCount = modelscount + props.size();
+        renderQueue->resize(drawCount);
+        // about one chunk per thread, but not so small that waking a thread costs more than its work
+        size_t chunk = std::max<size_t>(drawCount / (jobPool->Workers + 1), 2);
+        jobPool->parallelFor(drawCount, chunk, [&](size_t begin, size_t end)
+        {
+            // the scene objects of this chunk are culled together; the compact list is written
+            // to the chunk's own part of visibleObjects
+            size_t objectsEnd = std::min(end, (size_t)modelscount);
+            if (begin < objectsEnd)
+            {
+                size_t visibleCount = sceneBounds->cull(frustum, begin, objectsEnd, &visibleObjects[begin]);
+                std::fill(objectVisible.begin() + begin, objectVisible.begin() + objectsEnd, 0);
+                for (size_t k = 0; k < visibleCount; k++)
+                    objectVisible[visibleObjects[begin + k]] = 1;
+            }
+            for (size_t d = begin; d < end; d++)
+            {
+                DrawPacket packet;
+                if (d < (size_t)modelscount)
+                {
+                    int i = (int)d;
+                    if (!objectVisible[i])
+                    {
+                        renderQueue->hide(d);
+                        continue;
+                    }
+                    // per-pixel lighting only where the object is large enough on screen for it to show
+                    BoundingSphere bounds = transformSphere(objects[i].bounds, modelMatrices[i]);
+                    float pixels = projectedRadius(bounds, viewPos, projection, (float)renderHeight);
+                    ShadingModel shading = selectShading(pixels, lodThreshold);
+
+                    const StaticMeshBuffer::Mesh &mesh = staticMeshes->Meshes[objects[i].mesh];
+                    packet.Program = lightingPrograms[shading][materialVariant(objects[i])];
+                    packet.Texture = objects[i].texture;
+                    packet.VAO = staticMeshes->VAO;
+                    packet.DepthVAO = staticMeshes->DepthVAO;
+                    packet.Depth = glm::length(bounds.Center - viewPos);
+                    packet.Pass = objects[i].material;
+                    packet.First = mesh.First;
+                    packet.Count = mesh.Count;
+                    packet.Instances = nullptr;
+                    packet.Model = &identityModel;
+                    packet.NormalMatrix = &identityNormal;
+                }
+                else
+                {
+                    // repeated props, one instanced draw per file; the program is chosen by the
+                    // visible placement that is largest on screen and the depth by the nearest one.
+                    // The draw is culled only when no placement is visible.
+                    PropSet &prop = props[d - modelscount];
+                    size_t placements = prop.instances->Transforms.size();
+                    size_t visible = sceneBounds->cull(frustum, prop.firstBounds, prop.firstBounds + placements, &prop.visible[0]);
+                    float pixels = 0.0f;
+                    float depth = 1e30f;
+                    for (size_t k = 0; k < visible; k++)
+                    {
+                        size_t i = prop.visible[k] - prop.firstBounds;
+                        BoundingSphere bounds = transformSphere(prop.obj.bounds, prop.instances->Transforms[i]);
+                        pixels = glm::max(pixels, projectedRadius(bounds, viewPos, projection, (float)renderHeight));
+                        depth = glm::min(depth, glm::length(bounds.Center - viewPos));
+                    }
+                    if (visible == 0)
+                    {
+                        renderQueue->hide(d);
+                        continue;
+                    }
+                    ShadingModel shading = selectShading(pixels, lodThreshold);
+
+                    packet.Program = lightingPrograms[shading][VARIANT_INSTANCED | materialVariant(prop.obj)];
+                    packet.Texture = prop.obj.texture;
+                    packet.VAO = 0;
+                    packet.DepthVAO = 0;
+                    packet.Depth = depth;
+                    packet.Pass = prop.obj.material;
+                    packet.First = 0;
+                    packet.Count = 0;
+                    packet.Instances = prop.instances;
+                    packet.Model = nullptr;
+                    packet.NormalMatrix = nullptr;
+                }
+                renderQueue->set(d, packet);
+            }
+        });
+
+        // passes: below full resolution the scene goes to transient targets that the present
+        // pass scales up onto the window, otherwise straight to the window
+        // ------------------------------------------------------------------------------------
+        renderGraph->reset(screenWidth, screenHeight);
+        int sceneColor = RG_BACKBUFFER;
+        int sceneDepth = RG_BACKBUFFER;
+        if (scaled)
+        {
+            sceneColor = renderGraph->createTexture("scene color", renderWidth, renderHeight, GL_RGBA8);
+            sceneDepth = renderGraph->createTexture("scene depth", renderWidth, renderHeight, GL_DEPTH24_STENCIL8);
+        }
+        if (depthPrepass)
+        {
+            int pass = renderGraph->addPass("depth pre-pass", [&]() { renderQueue->drawDepth(); });
+            renderGraph->write(pass, sceneDepth);
+        }
+        int opaquePass = renderGraph->addPass("opaque", [&]() { renderQueue->drawPasses(MATERIAL_OPAQUE, MATERIAL_ALPHA_TESTED); });
+        renderGraph->write(opaquePass, sceneColor);
+        renderGraph->write(opaquePass, sceneDepth);
+        // the cube is placed at lightPos from the frame uniforms
+        AABB sunBox = sun.box;
+        sunBox.Min += lightPos;
+        sunBox.Max += lightPos;
+        if (frustum.intersects(sunBox))
+        {
+            int lightPass = renderGraph->addPass("light cube", [&]()
+            {
+                lightCubeShader.use();
+                glState().bindVertexArray(sun.VAO);
+                glDrawArrays(GL_TRIANGLES, 0, sun.pointsCount);
+            });
+            renderGraph->write(lightPass, sceneColor);
+            renderGraph->write(lightPass, sceneDepth);
+        }
+        int blendedPass = renderGraph->addPass("transparent", [&]() { renderQueue->drawPasses(MATERIAL_BLENDED, MATERIAL_BLENDED); });
+        renderGraph->write(blendedPass, sceneColor);
+        renderGraph->write(blendedPass, sceneDepth);
+        if (scaled)
         {
-            glBindTexture(GL_TEXTURE_2D, objects[i].texture);
-            lightingShader.setBool("drawTexture", objects[i].loadedTexture);
-            glBindVertexArray(objects[i].VAO);
-            glDrawArrays(GL_TRIANGLES, 0, objects[i].pointsCount);
+            int presentPass = renderGraph->addPass("present", [&]()
+            {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, renderGraph->framebuffer(sceneColor));
+                glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, screenWidth, screenHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            });
+            renderGraph->read(presentPass, sceneColor);
+            renderGraph->write(presentPass, RG_BACKBUFFER);
         }
 
-        lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, lightPos);
-        lightCubeShader.setMat4("model", model);
+        // submission: sort the queue, then run the passes on the context thread
+        // ---------------------------------------------------------------------
+        renderQueue->prepare();
+        gpuTimer->begin();
+        if (renderGraph->compile())
+            renderGraph->execute();
+        gpuTimer->end();
+        frameRing->endFrame();
 
-        glBindVertexArray(sun.VAO);
-        glDrawArrays(GL_TRIANGLES, 0, sun.pointsCount);
+        // the slower of the two sides sets the frame rate; the GPU time arrives a few frames late
+        double cpuTime = (glfwGetTime() - cpuStart) * 1000.0;
+        if (qualityGovernor->update(cpuTime, gpuTimer->LastTime))
+            std::cout << "Quality level = " << qualityGovernor->Level << " (" << qualityGovernor->current().ResolutionScale * 100.0f << "% resolution)" << std::endl;
 
         glfwSwapBuffers(window);
+        framePacer->endFrame();
         glfwPollEvents();
     }
 
+    std::cout << "GL state calls: " << glState().Counters.Issued << " issued, " << glState().Counters.Filtered << " filtered as redundant" << std::endl;
+
     // optional: de-allocate all resources once they've outlived their purpose:
 
-    for (int i = 0; i < modelscount; i++)
-    {
-        glDeleteVertexArrays(1, &objects[i].VAO);
-        glDeleteBuffers(1, &objects[i].VBO);
-    }
+    for (size_t p = 0; p < props.size(); p++)
+        delete props[p].instances;
+    delete staticMeshes;
+    delete sceneBounds;
+    delete renderQueue;
+    delete jobPool;
+    delete framePacer;
+    delete qualityGovernor;
+    delete gpuTimer;
+    delete renderGraph;
     // ------------------------------------------------------------------------
 
+    glState().forgetVertexArray(sun.VAO);
     glDeleteVertexArrays(1, &sun.VAO);
     glDeleteBuffers(1, &sun.VBO);
+    delete textureUploader;
+    delete frameUniforms;
+    delete frameRing;
+    delete shaderReloader;
+    delete lightingShaders[SHADING_PHONG];
+    delete lightingShaders[SHADING_GOURAUD];
+    delete depthShaders;
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -323,15 +741,28 @@ void processInput(GLFWwindow *window)
         glfwSetWindowShouldClose(window, true);
 
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    {
         camera.ProcessKeyboard(FORWARD, deltaTime);
+        frameDirty = true;
+    }
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    {
         camera.ProcessKeyboard(BACKWARD, deltaTime);
+        frameDirty = true;
+    }
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    {
         camera.ProcessKeyboard(LEFT, deltaTime);
+        frameDirty = true;
+    }
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    {
         camera.ProcessKeyboard(RIGHT, deltaTime);
+        frameDirty = true;
+    }
     if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS)
     {
+        frameDirty = true;
         specularStrength += 0.01f;
         if (specularStrength > 5.0f)
             specularStrength = 5.0f;
@@ -339,6 +770,7 @@ void processInput(GLFWwindow *window)
     }
     if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
     {
+        frameDirty = true;
         specularStrength -= 0.01f;
         if (specularStrength < 0.0f)
             specularStrength = 0.0f;
@@ -353,6 +785,7 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    frameDirty = true;
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -373,6 +806,7 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos)
     lastY = ypos;
 
     camera.ProcessMouseMovement(xoffset, yoffset);
+    frameDirty = true;
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
@@ -380,4 +814,46 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos)
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(yoffset);
+    frameDirty = true;
+}
+
+// glfw: toggles that must fire once per key press rather than while the key is held
+// ----------------------------------------------------------------------------------
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_R)
+    {
+        renderOnDemand = !renderOnDemand;
+        std::cout << "Render on demand = " << renderOnDemand << std::endl;
+    }
+    if (key == GLFW_KEY_P)
+    {
+        animateLight = !animateLight;
+        std::cout << "Animated light = " << animateLight << std::endl;
+    }
+    if (key == GLFW_KEY_F)
+    {
+        lowLatency = !lowLatency;
+        std::cout << "Low latency = " << lowLatency << std::endl;
+    }
+    if (key == GLFW_KEY_G)
+    {
+        adaptiveQuality = !adaptiveQuality;
+        std::cout << "Adaptive quality = " << adaptiveQuality << std::endl;
+    }
+    if (key == GLFW_KEY_Z)
+    {
+        depthPrepass = !depthPrepass;
+        std::cout << "Depth pre-pass = " << depthPrepass << std::endl;
+    }
+    frameDirty = true;
+}
+
+// glfw: the window contents were damaged (uncovered, restored) and must be drawn again
+// ------------------------------------------------------------------------------------
+void refresh_callback(GLFWwindow *window)
+{
+    frameDirty = true;
 }
@@ -0,0 +1,24 @@
+#version 330 core
+// depth pre-pass: reads only the position-only stream, see lib/static_mesh.h
+layout (location = 0) in vec3 aPos;
+#ifdef INSTANCED
+layout (location = 4) in mat4 aInstanceModel;
+#endif
+
+#include "frame_data.glsl"
+#include "object_data.glsl"
+
+// the shading pass tests against this depth with GL_EQUAL, so the position must be
+// computed exactly like in the lighting vertex shaders
+invariant gl_Position;
+
+void main()
+{
+#ifdef INSTANCED
+    mat4 objectModel = aInstanceModel;
+#else
+    mat4 objectModel = model;
+#endif
+    vec3 position = vec3(objectModel * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(position, 1.0);
+}
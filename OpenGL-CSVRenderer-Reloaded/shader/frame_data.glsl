@@ -0,0 +1,10 @@
+// per-frame values shared by every program, filled from FrameData in lib/frame_uniforms.h
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    vec3 lightPos;
+    vec3 lightColor;
+    float specularStrength;
+};
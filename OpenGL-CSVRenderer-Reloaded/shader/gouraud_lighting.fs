@@ -0,0 +1,25 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 LightingColor;
+in vec2 TextCoord;
+
+// TEXTURED is injected by the program variant for objects that have a texture, ALPHA_TEST
+// for textures with cut-out (fully transparent) texels, see lib/material.h
+#ifdef TEXTURED
+uniform sampler2D ourTexture;
+#endif
+
+void main()
+{
+#ifdef TEXTURED
+    vec4 texel = texture(ourTexture, TextCoord);
+#ifdef ALPHA_TEST
+    if (texel.a < 0.5)
+        discard;
+#endif
+    FragColor = texel * vec4(LightingColor, 1.0);
+#else
+    FragColor = vec4(LightingColor, 1.0);
+#endif
+}
@@ -1,13 +1,10 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "frame_data.glsl"
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	// the cube marks the light, so its placement comes with the per-frame data
+	gl_Position = projection * view * vec4(aPos + lightPos, 1.0);
 }
-
-
@@ -0,0 +1,24 @@
+// Lighting model shared by the per-pixel (Phong) and per-vertex (Gouraud) programs so both
+// produce the same colors; needs frame_data.glsl included first.
+
+// ambient + diffuse + specular light arriving at a world space position
+vec3 computeLighting(vec3 position, vec3 normal)
+{
+    // ambient
+    float ambientStrength = 0.1;
+    vec3 ambient = ambientStrength * lightColor;
+
+    // diffuse 
+    vec3 norm = normalize(normal);
+    vec3 lightDir = normalize(lightPos - position);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * lightColor;
+
+    // specular
+    vec3 viewDir = normalize(viewPos - position);
+    vec3 reflectDir = reflect(-lightDir, norm);  
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = specularStrength * spec * lightColor;  
+
+    return ambient + diffuse + specular;
+}
@@ -0,0 +1,7 @@
+// transform of one non-instanced draw, filled from ObjectData in lib/frame_uniforms.h
+layout (std140) uniform ObjectData
+{
+    mat4 model;
+    // transpose(inverse(mat3(model))), computed once per object on the CPU
+    mat3 normalMatrix;
+};
@@ -6,42 +6,31 @@ in vec3 FragPos;
 in vec3 ObjColor;  
 in vec2 TextCoord;
 
-uniform vec3 lightPos; 
-uniform vec3 viewPos; 
-uniform vec3 lightColor;
+#include "frame_data.glsl"
+#include "lighting.glsl"
 //uniform vec3 objectColor;
-uniform float specularStrength;
 
-uniform bool drawTexture;
+// TEXTURED is injected by the program variant for objects that have a texture, ALPHA_TEST
+// for textures with cut-out (fully transparent) texels, see lib/material.h
+#ifdef TEXTURED
 uniform sampler2D ourTexture;
+#endif
 
 void main()
 {
-    // ambient
-    float ambientStrength = 0.1;
-    vec3 ambient = ambientStrength * lightColor;
-  	
     vec3 objectColor = ObjColor;
-
-    // diffuse 
-    vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
-
-    // specular
-    // float specularStrength = 0.5;
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);  
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor;  
-        
-    vec3 result = (ambient + diffuse + specular) * objectColor;
-
-    if(drawTexture)
-        FragColor = texture(ourTexture, TextCoord) * vec4(result, 1.0);
-    else
-        FragColor = vec4(result, 1.0);
+    vec3 result = computeLighting(FragPos, Normal) * objectColor;
+
+#ifdef TEXTURED
+    vec4 texel = texture(ourTexture, TextCoord);
+#ifdef ALPHA_TEST
+    if (texel.a < 0.5)
+        discard;
+#endif
+    FragColor = texel * vec4(result, 1.0);
+#else
+    FragColor = vec4(result, 1.0);
+#endif
 } 
 
 
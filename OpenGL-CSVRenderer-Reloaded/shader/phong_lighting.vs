@@ -3,21 +3,39 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec3 aColor;
 layout (location = 3) in vec2 aTextureCoord;
+// INSTANCED is injected by the program variant for meshes drawn with glDrawArraysInstanced;
+// the placement then comes from per-instance attributes instead of the ObjectData block
+#ifdef INSTANCED
+layout (location = 4) in mat4 aInstanceModel;
+layout (location = 8) in mat3 aInstanceNormalMatrix;
+layout (location = 11) in vec3 aInstanceTint;
+#endif
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec3 ObjColor;
 out vec2 TextCoord;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "frame_data.glsl"
+#include "object_data.glsl"
+
+// must match shader/depth_prepass.vs bit for bit, the pre-pass depth is tested with GL_EQUAL
+invariant gl_Position;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
-    ObjColor = aColor;
+#ifdef INSTANCED
+    mat4 objectModel = aInstanceModel;
+    mat3 objectNormalMatrix = aInstanceNormalMatrix;
+    vec3 tint = aInstanceTint;
+#else
+    mat4 objectModel = model;
+    mat3 objectNormalMatrix = normalMatrix;
+    vec3 tint = vec3(1.0);
+#endif
+    FragPos = vec3(objectModel * vec4(aPos, 1.0));
+    Normal = objectNormalMatrix * aNormal;
+    ObjColor = aColor * tint;
     TextCoord = aTextureCoord;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
@@ -1,3 +1,660 @@
 #define STB_IMAGE_IMPLEMENTATION
+// the stock file loader is renamed so that stbi_load below can try the fast PNG path first
+#define stbi_load stbi__stock_load
 #include "stb_image.h"
+#undef stbi_load
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  fast PNG path
+//
+//    handles the common case of our textures: 8-bit, non-interlaced,
+//    grey/grey+alpha/RGB/RGBA without tRNS. Anything else (and any
+//    decode error) falls back to the stock decoder, which also produces
+//    the error message.
+//
+//    performance
+//      - 64-bit bit buffer refilled 7 bytes at a time
+//      - 10-bit huffman tables holding pre-decoded length/distance bases
+//      - exact-size output buffer, so no growth checks while inflating
+//      - 8-byte match copies
+//      - SSE2 sub/avg/paeth unfilter for 3 and 4 byte pixels
+
+#define STBI__FPNG_FAST_BITS  10
+#define STBI__FPNG_FAST_MASK  ((1 << STBI__FPNG_FAST_BITS) - 1)
+#define STBI__FPNG_SLACK      16   // output overshoot allowed for 8-byte match copies
+
+typedef unsigned long long stbi__fpng_uint64;
+
+// table entry layout:
+//    bits  0..3   code length (0 = not resolved by the fast table)
+//    bits  4..5   kind
+//    bits  8..11  extra bits to read after the code
+//    bits 16..31  literal byte, or base length/distance
+enum
+{
+   STBI__FPNG_LITERAL = 0,
+   STBI__FPNG_MATCH   = 1,
+   STBI__FPNG_END     = 2,
+   STBI__FPNG_INVALID = 3
+};
+
+typedef struct
+{
+   stbi__uint32 fast[1 << STBI__FPNG_FAST_BITS];
+   stbi__uint16 firstcode[16];
+   int maxcode[17];
+   stbi__uint16 firstsymbol[16];
+   stbi_uc  size[288];
+   stbi__uint32 entry[288];
+} stbi__fpng_huffman;
+
+typedef struct
+{
+   const stbi_uc *in, *in_end;
+   stbi__fpng_uint64 bits;
+   int num_bits;
+   int pad;   // zero bytes shifted in past the end of the input
+
+   stbi_uc *out, *out_start, *out_end;
+
+   stbi__fpng_huffman litlen, dist;
+} stbi__fpng_zbuf;
+
+static stbi__uint32 stbi__fpng_litlen_entry(int sym)
+{
+   if (sym < 256)  return ((stbi__uint32) sym << 16) | (STBI__FPNG_LITERAL << 4);
+   if (sym == 256) return STBI__FPNG_END << 4;
+   if (sym >= 286) return STBI__FPNG_INVALID << 4;
+   return ((stbi__uint32) stbi__zlength_base[sym-257] << 16) | (stbi__zlength_extra[sym-257] << 8) | (STBI__FPNG_MATCH << 4);
+}
+
+static stbi__uint32 stbi__fpng_dist_entry(int sym)
+{
+   if (sym >= 30) return STBI__FPNG_INVALID << 4;
+   return ((stbi__uint32) stbi__zdist_base[sym] << 16) | (stbi__zdist_extra[sym] << 8) | (STBI__FPNG_MATCH << 4);
+}
+
+static stbi__uint32 stbi__fpng_plain_entry(int sym)
+{
+   return ((stbi__uint32) sym << 16) | (STBI__FPNG_LITERAL << 4);
+}
+
+// same canonical construction as stbi__zbuild_huffman, but the fast table stores full entries
+static int stbi__fpng_build_huffman(stbi__fpng_huffman *z, const stbi_uc *sizelist, int num, stbi__uint32 (*entry_of)(int))
+{
+   int i,k=0;
+   int code, next_code[16], sizes[17];
+
+   memset(sizes, 0, sizeof(sizes));
+   memset(z->fast, 0, sizeof(z->fast));
+   for (i=0; i < num; ++i)
+      ++sizes[sizelist[i]];
+   sizes[0] = 0;
+   for (i=1; i < 16; ++i)
+      if (sizes[i] > (1 << i))
+         return 0;
+   code = 0;
+   for (i=1; i < 16; ++i) {
+      next_code[i] = code;
+      z->firstcode[i] = (stbi__uint16) code;
+      z->firstsymbol[i] = (stbi__uint16) k;
+      code = (code + sizes[i]);
+      if (sizes[i])
+         if (code-1 >= (1 << i)) return 0;
+      z->maxcode[i] = code << (16-i);
+      code <<= 1;
+      k += sizes[i];
+   }
+   z->maxcode[16] = 0x10000;
+   for (i=0; i < num; ++i) {
+      int s = sizelist[i];
+      if (s) {
+         int c = next_code[s] - z->firstcode[s] + z->firstsymbol[s];
+         stbi__uint32 e = entry_of(i);
+         z->size [c] = (stbi_uc) s;
+         z->entry[c] = e;
+         if (s <= STBI__FPNG_FAST_BITS) {
+            int j = stbi__bit_reverse(next_code[s],s);
+            while (j < (1 << STBI__FPNG_FAST_BITS)) {
+               z->fast[j] = e | (stbi__uint32) s;
+               j += (1 << s);
+            }
+         }
+         ++next_code[s];
+      }
+   }
+   return 1;
+}
+
+// tops the bit buffer up to at least 56 bits
+stbi_inline static void stbi__fpng_refill(stbi__fpng_zbuf *z)
+{
+   if (z->in_end - z->in >= 8) {
+      const stbi_uc *p = z->in;
+      stbi__fpng_uint64 v = (stbi__fpng_uint64) p[0]       | ((stbi__fpng_uint64) p[1] << 8)  |
+                      ((stbi__fpng_uint64) p[2] << 16) | ((stbi__fpng_uint64) p[3] << 24) |
+                      ((stbi__fpng_uint64) p[4] << 32) | ((stbi__fpng_uint64) p[5] << 40) |
+                      ((stbi__fpng_uint64) p[6] << 48) | ((stbi__fpng_uint64) p[7] << 56);
+      z->bits |= v << z->num_bits;
+      z->in += (63 - z->num_bits) >> 3;
+      z->num_bits |= 56;
+   } else {
+      while (z->num_bits <= 56) {
+         if (z->in < z->in_end)
+            z->bits |= (stbi__fpng_uint64) *z->in++ << z->num_bits;
+         else
+            ++z->pad;
+         z->num_bits += 8;
+      }
+   }
+}
+
+stbi_inline static unsigned int stbi__fpng_receive(stbi__fpng_zbuf *z, int n)
+{
+   unsigned int k = (unsigned int) (z->bits & ((1U << n) - 1));
+   z->bits >>= n;
+   z->num_bits -= n;
+   return k;
+}
+
+// returns the table entry for the next symbol; needs at least 15 bits buffered
+stbi_inline static stbi__uint32 stbi__fpng_decode(stbi__fpng_zbuf *a, stbi__fpng_huffman *z)
+{
+   int b,s,k;
+   stbi__uint32 e = z->fast[a->bits & STBI__FPNG_FAST_MASK];
+   if (e & 15) {
+      s = e & 15;
+      a->bits >>= s;
+      a->num_bits -= s;
+      return e;
+   }
+   k = stbi__bit_reverse((int) (a->bits & 0xffff), 16);
+   for (s=STBI__FPNG_FAST_BITS+1; ; ++s)
+      if (k < z->maxcode[s])
+         break;
+   if (s >= 16) return STBI__FPNG_INVALID << 4;
+   b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+   if (b >= (int) sizeof(z->size) || z->size[b] != s) return STBI__FPNG_INVALID << 4;
+   a->bits >>= s;
+   a->num_bits -= s;
+   return z->entry[b] | (stbi__uint32) s;
+}
+
+static int stbi__fpng_parse_huffman_block(stbi__fpng_zbuf *a)
+{
+   stbi_uc *zout = a->out;
+   for (;;) {
+      stbi__uint32 e;
+      int len, dist, extra;
+      stbi_uc *p;
+
+      // a refill holds at least 56 bits, so runs of literals refill only every few symbols
+      if (a->num_bits < 15) stbi__fpng_refill(a);
+      e = stbi__fpng_decode(a, &a->litlen);
+      if (((e >> 4) & 3) == STBI__FPNG_LITERAL) {
+         if (zout >= a->out_end) return 0;
+         *zout++ = (stbi_uc) (e >> 16);
+         continue;
+      }
+      if (((e >> 4) & 3) == STBI__FPNG_END) {
+         a->out = zout;
+         return 1;
+      }
+      if (((e >> 4) & 3) == STBI__FPNG_INVALID) return 0;
+
+      // length extra bits, distance code and distance extra bits need at most 33 bits
+      if (a->num_bits < 33) stbi__fpng_refill(a);
+      len = e >> 16;
+      extra = (e >> 8) & 15;
+      if (extra) len += stbi__fpng_receive(a, extra);
+      e = stbi__fpng_decode(a, &a->dist);
+      if (((e >> 4) & 3) != STBI__FPNG_MATCH) return 0;
+      dist = e >> 16;
+      extra = (e >> 8) & 15;
+      if (extra) dist += stbi__fpng_receive(a, extra);
+
+      if (zout - a->out_start < dist) return 0;
+      if (a->out_end - zout < len) return 0;
+      p = zout - dist;
+      if (dist >= 8) {
+         // chunks never overlap, and the overshoot lands in the slack past out_end
+         stbi_uc *end = zout + len;
+         do {
+            memcpy(zout, p, 8);
+            zout += 8;
+            p += 8;
+         } while (zout < end);
+         zout = end;
+      } else if (dist == 1) {
+         memset(zout, *p, len);
+         zout += len;
+      } else {
+         do *zout++ = *p++; while (--len);
+      }
+   }
+}
+
+static int stbi__fpng_compute_huffman_codes(stbi__fpng_zbuf *a)
+{
+   static const stbi_uc length_dezigzag[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+   stbi__fpng_huffman z_codelength;
+   stbi_uc lencodes[286+32+137];//padding for maximum single op
+   stbi_uc codelength_sizes[19];
+   int i,n;
+
+   int hlit, hdist, hclen, ntot;
+   stbi__fpng_refill(a);
+   hlit  = stbi__fpng_receive(a,5) + 257;
+   hdist = stbi__fpng_receive(a,5) + 1;
+   hclen = stbi__fpng_receive(a,4) + 4;
+   ntot  = hlit + hdist;
+
+   memset(codelength_sizes, 0, sizeof(codelength_sizes));
+   for (i=0; i < hclen; ++i) {
+      if (a->num_bits < 3) stbi__fpng_refill(a);
+      codelength_sizes[length_dezigzag[i]] = (stbi_uc) stbi__fpng_receive(a,3);
+   }
+   if (!stbi__fpng_build_huffman(&z_codelength, codelength_sizes, 19, stbi__fpng_plain_entry)) return 0;
+
+   n = 0;
+   while (n < ntot) {
+      stbi__uint32 e;
+      int c;
+      stbi__fpng_refill(a);
+      e = stbi__fpng_decode(a, &z_codelength);
+      if (((e >> 4) & 3) != STBI__FPNG_LITERAL) return 0;
+      c = e >> 16;
+      if (c >= 19) return 0;
+      if (c < 16)
+         lencodes[n++] = (stbi_uc) c;
+      else {
+         stbi_uc fill = 0;
+         if (c == 16) {
+            c = stbi__fpng_receive(a,2)+3;
+            if (n == 0) return 0;
+            fill = lencodes[n-1];
+         } else if (c == 17) {
+            c = stbi__fpng_receive(a,3)+3;
+         } else {
+            c = stbi__fpng_receive(a,7)+11;
+         }
+         if (ntot - n < c) return 0;
+         memset(lencodes+n, fill, c);
+         n += c;
+      }
+   }
+   if (!stbi__fpng_build_huffman(&a->litlen, lencodes, hlit, stbi__fpng_litlen_entry)) return 0;
+   if (!stbi__fpng_build_huffman(&a->dist, lencodes+hlit, hdist, stbi__fpng_dist_entry)) return 0;
+   return 1;
+}
+
+static int stbi__fpng_parse_uncompressed_block(stbi__fpng_zbuf *a)
+{
+   int rewind, len, nlen;
+   // drop to a byte boundary, then hand the buffered whole bytes back to the input
+   stbi__fpng_receive(a, a->num_bits & 7);
+   rewind = a->num_bits >> 3;
+   if (a->pad >= rewind) {
+      a->pad -= rewind;
+      rewind = 0;
+   } else {
+      rewind -= a->pad;
+      a->pad = 0;
+   }
+   a->in -= rewind;
+   a->bits = 0;
+   a->num_bits = 0;
+   if (a->pad) return 0;
+
+   if (a->in_end - a->in < 4) return 0;
+   len  = a->in[0] | (a->in[1] << 8);
+   nlen = a->in[2] | (a->in[3] << 8);
+   a->in += 4;
+   if (nlen != (len ^ 0xffff)) return 0;
+   if (a->in_end - a->in < len) return 0;
+   if (a->out_end - a->out < len) return 0;
+   memcpy(a->out, a->in, len);
+   a->in += len;
+   a->out += len;
+   return 1;
+}
+
+static int stbi__fpng_inflate(stbi__fpng_zbuf *a)
+{
+   static const stbi_uc fixed_length[288] = {
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+      9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+      9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+      9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,
+      7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,8,8,8,8,8,8,8,8 };
+   static const stbi_uc fixed_distance[32] = {
+      5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5 };
+   int final, type;
+
+   // zlib header
+   if (a->in_end - a->in < 2) return 0;
+   {
+      int cmf = a->in[0];
+      int flg = a->in[1];
+      if ((cmf*256+flg) % 31 != 0) return 0;
+      if (flg & 32) return 0;
+      if ((cmf & 15) != 8) return 0;
+      a->in += 2;
+   }
+
+   do {
+      stbi__fpng_refill(a);
+      final = stbi__fpng_receive(a,1);
+      type = stbi__fpng_receive(a,2);
+      if (type == 0) {
+         if (!stbi__fpng_parse_uncompressed_block(a)) return 0;
+      } else if (type == 3) {
+         return 0;
+      } else {
+         if (type == 1) {
+            if (!stbi__fpng_build_huffman(&a->litlen, fixed_length, 288, stbi__fpng_litlen_entry)) return 0;
+            if (!stbi__fpng_build_huffman(&a->dist, fixed_distance, 32, stbi__fpng_dist_entry)) return 0;
+         } else {
+            if (!stbi__fpng_compute_huffman_codes(a)) return 0;
+         }
+         if (!stbi__fpng_parse_huffman_block(a)) return 0;
+      }
+      // consumed more bits than the stream had
+      if (a->pad * 8 > a->num_bits) return 0;
+   } while (!final);
+   return a->out == a->out_end;
+}
+
+// scalar unfilter of one row; 'prior' is the previous reconstructed row (zeros for the first)
+static void stbi__fpng_unfilter_row(stbi_uc *dst, const stbi_uc *src, const stbi_uc *prior, int filter, int bytes, int bpp)
+{
+   int i;
+   switch (filter) {
+      case STBI__F_none:
+         memcpy(dst, src, bytes);
+         break;
+      case STBI__F_sub:
+         for (i=0; i < bpp; ++i) dst[i] = src[i];
+         for (   ; i < bytes; ++i) dst[i] = STBI__BYTECAST(src[i] + dst[i-bpp]);
+         break;
+      case STBI__F_up:
+         for (i=0; i < bytes; ++i) dst[i] = STBI__BYTECAST(src[i] + prior[i]);
+         break;
+      case STBI__F_avg:
+         for (i=0; i < bpp; ++i) dst[i] = STBI__BYTECAST(src[i] + (prior[i]>>1));
+         for (   ; i < bytes; ++i) dst[i] = STBI__BYTECAST(src[i] + ((prior[i] + dst[i-bpp])>>1));
+         break;
+      case STBI__F_paeth:
+         for (i=0; i < bpp; ++i) dst[i] = STBI__BYTECAST(src[i] + prior[i]);
+         for (   ; i < bytes; ++i) dst[i] = STBI__BYTECAST(src[i] + stbi__paeth(dst[i-bpp],prior[i],prior[i-bpp]));
+         break;
+   }
+}
+
+#ifdef STBI_SSE2
+// pixels move through a 32-bit scalar. For 3-byte pixels every pixel but the last is
+// accessed 4 bytes wide; the stray 4th byte lands in the next pixel's slot and is
+// rewritten by the following iteration, so only the last pixel needs an exact copy.
+template <int bpp>
+stbi_inline static __m128i stbi__fpng_load(const stbi_uc *p, int last)
+{
+   int v = 0;
+   if (bpp == 4 || !last)
+      memcpy(&v, p, 4);
+   else
+      memcpy(&v, p, 3);
+   return _mm_cvtsi32_si128(v);
+}
+
+template <int bpp>
+stbi_inline static void stbi__fpng_store(stbi_uc *p, __m128i v, int last)
+{
+   int t = _mm_cvtsi128_si32(v);
+   if (bpp == 4 || !last)
+      memcpy(p, &t, 4);
+   else
+      memcpy(p, &t, 3);
+}
+
+stbi_inline static __m128i stbi__fpng_abs16(__m128i x)
+{
+   return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+stbi_inline static __m128i stbi__fpng_select(__m128i c, __m128i t, __m128i e)
+{
+   return _mm_or_si128(_mm_and_si128(c, t), _mm_andnot_si128(c, e));
+}
+
+// the sub/avg/paeth recurrences depend on the previous pixel, so these run one pixel per
+// iteration with all channels in one register; 'up' has no such dependency and runs 16 wide
+template <int bpp>
+static void stbi__fpng_unfilter_row_sse2(stbi_uc *dst, const stbi_uc *src, const stbi_uc *prior, int filter, int bytes)
+{
+   __m128i zero = _mm_setzero_si128();
+   int i = 0, last = bytes - bpp;
+   switch (filter) {
+      case STBI__F_none:
+         memcpy(dst, src, bytes);
+         break;
+      case STBI__F_up:
+         for (; i + 16 <= bytes; i += 16) {
+            __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+            __m128i p = _mm_loadu_si128((const __m128i *) (prior + i));
+            _mm_storeu_si128((__m128i *) (dst + i), _mm_add_epi8(s, p));
+         }
+         for (; i < bytes; ++i) dst[i] = STBI__BYTECAST(src[i] + prior[i]);
+         break;
+      case STBI__F_sub: {
+         __m128i a = zero;
+         for (; i < bytes; i += bpp) {
+            a = _mm_add_epi8(a, stbi__fpng_load<bpp>(src + i, i == last));
+            stbi__fpng_store<bpp>(dst + i, a, i == last);
+         }
+         break;
+      }
+      case STBI__F_avg: {
+         __m128i a = zero;
+         __m128i one = _mm_set1_epi8(1);
+         for (; i < bytes; i += bpp) {
+            __m128i b = stbi__fpng_load<bpp>(prior + i, i == last);
+            // _mm_avg_epu8 rounds up; subtract the rounding bit to get floor((a+b)/2)
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(stbi__fpng_load<bpp>(src + i, i == last), avg);
+            stbi__fpng_store<bpp>(dst + i, a, i == last);
+         }
+         break;
+      }
+      case STBI__F_paeth: {
+         // 16-bit lanes so the predictor distances don't overflow
+         __m128i a = zero, b = zero, c, d;
+         for (; i < bytes; i += bpp) {
+            __m128i pa, pb, pc, smallest, nearest;
+            c = b;
+            b = _mm_unpacklo_epi8(stbi__fpng_load<bpp>(prior + i, i == last), zero);
+            d = _mm_unpacklo_epi8(stbi__fpng_load<bpp>(src + i, i == last), zero);
+            pa = _mm_sub_epi16(b, c);       // p-a == b-c
+            pb = _mm_sub_epi16(a, c);       // p-b == a-c
+            pc = _mm_add_epi16(pa, pb);     // p-c == (b-c)+(a-c)
+            pa = stbi__fpng_abs16(pa);
+            pb = stbi__fpng_abs16(pb);
+            pc = stbi__fpng_abs16(pc);
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            // ties favour a over b over c
+            nearest = stbi__fpng_select(_mm_cmpeq_epi16(smallest, pa), a,
+                      stbi__fpng_select(_mm_cmpeq_epi16(smallest, pb), b, c));
+            a = _mm_add_epi8(d, nearest);   // wraps each byte; high bytes stay zero
+            stbi__fpng_store<bpp>(dst + i, _mm_packus_epi16(a, a), i == last);
+         }
+         break;
+      }
+   }
+}
+#endif // STBI_SSE2
+
+static stbi__uint32 stbi__fpng_be32(const stbi_uc *p)
+{
+   return ((stbi__uint32) p[0] << 24) | ((stbi__uint32) p[1] << 16) | ((stbi__uint32) p[2] << 8) | p[3];
+}
+
+static stbi_uc *stbi__fpng_load_from_memory(const stbi_uc *buffer, size_t len, int *x, int *y, int *comp, int req_comp)
+{
+   static const stbi_uc png_sig[8] = { 137,80,78,71,13,10,26,10 };
+   const stbi_uc *p = buffer, *end = buffer + len;
+   stbi_uc *idata = NULL, *raw = NULL, *out = NULL, *zero = NULL;
+   size_t ilen = 0, icap = 0;
+   stbi__uint32 w = 0, h = 0;
+   int n = 0, first = 1, ok = 0;
+
+   if (len < 8 || memcmp(p, png_sig, 8) != 0) return NULL;
+   p += 8;
+
+   // gather the IDAT stream, bailing out on anything the fast path doesn't handle
+   for (;;) {
+      stbi__uint32 clen, type;
+      if (end - p < 12) goto done;
+      clen = stbi__fpng_be32(p);
+      type = stbi__fpng_be32(p + 4);
+      p += 8;
+      if ((size_t) (end - p) < (size_t) clen + 4) goto done;
+      if (first && type != STBI__PNG_TYPE('I','H','D','R')) goto done;
+      switch (type) {
+         case STBI__PNG_TYPE('I','H','D','R'): {
+            int depth, color;
+            if (!first || clen != 13) goto done;
+            w = stbi__fpng_be32(p);
+            h = stbi__fpng_be32(p + 4);
+            depth = p[8];
+            color = p[9];
+            if (w == 0 || h == 0 || w > (stbi__uint32) STBI_MAX_DIMENSIONS || h > (stbi__uint32) STBI_MAX_DIMENSIONS) goto done;
+            if (depth != 8 || p[10] != 0 || p[11] != 0 || p[12] != 0) goto done;
+            if      (color == 0) n = 1;
+            else if (color == 2) n = 3;
+            else if (color == 4) n = 2;
+            else if (color == 6) n = 4;
+            else goto done;
+            if ((size_t) w * n > ((size_t) 1 << 30) / h) goto done;
+            first = 0;
+            break;
+         }
+         case STBI__PNG_TYPE('I','D','A','T'):
+            if (ilen + clen > icap) {
+               size_t cap = icap ? icap : 65536;
+               stbi_uc *q;
+               while (cap < ilen + clen) cap *= 2;
+               q = (stbi_uc *) STBI_REALLOC_SIZED(idata, icap, cap);
+               if (q == NULL) goto done;
+               idata = q;
+               icap = cap;
+            }
+            memcpy(idata + ilen, p, clen);
+            ilen += clen;
+            break;
+         case STBI__PNG_TYPE('I','E','N','D'):
+            goto decode;
+         case STBI__PNG_TYPE('t','R','N','S'):
+         case STBI__PNG_TYPE('C','g','B','I'):
+            goto done;
+         default:
+            // unknown critical chunk
+            if ((type & (1 << 29)) == 0) goto done;
+            break;
+      }
+      p += clen + 4;
+   }
+
+decode:
+   if (idata == NULL) goto done;
+   {
+      size_t stride = (size_t) w * n;
+      size_t raw_len = (stride + 1) * h;
+      stbi__fpng_zbuf *z;
+      stbi__uint32 j;
+
+      z = (stbi__fpng_zbuf *) STBI_MALLOC(sizeof(*z));
+      raw = (stbi_uc *) STBI_MALLOC(raw_len + STBI__FPNG_SLACK);
+      out = (stbi_uc *) STBI_MALLOC(stride * h);
+      zero = (stbi_uc *) STBI_MALLOC(stride + 16);
+      if (z == NULL || raw == NULL || out == NULL || zero == NULL) {
+         STBI_FREE(z);
+         goto done;
+      }
+      memset(z, 0, sizeof(*z));
+      z->in = idata;
+      z->in_end = idata + ilen;
+      z->out = z->out_start = raw;
+      z->out_end = raw + raw_len;
+      if (!stbi__fpng_inflate(z)) {
+         STBI_FREE(z);
+         goto done;
+      }
+      STBI_FREE(z);
+
+      memset(zero, 0, stride + 16);
+      for (j=0; j < h; ++j) {
+         const stbi_uc *src = raw + j * (stride + 1);
+         const stbi_uc *prior = j ? out + (j-1) * stride : zero;
+         if (src[0] > STBI__F_paeth) goto done;
+#ifdef STBI_SSE2
+         if (n == 4)
+            stbi__fpng_unfilter_row_sse2<4>(out + j * stride, src + 1, prior, src[0], (int) stride);
+         else if (n == 3)
+            stbi__fpng_unfilter_row_sse2<3>(out + j * stride, src + 1, prior, src[0], (int) stride);
+         else
+#endif
+         stbi__fpng_unfilter_row(out + j * stride, src + 1, prior, src[0], (int) stride, n);
+      }
+      ok = 1;
+   }
+
+done:
+   STBI_FREE(idata);
+   STBI_FREE(raw);
+   STBI_FREE(zero);
+   if (!ok) {
+      STBI_FREE(out);
+      return NULL;
+   }
+
+   *x = (int) w;
+   *y = (int) h;
+   if (comp) *comp = n;
+   if (req_comp && req_comp != n) {
+      out = stbi__convert_format(out, n, req_comp, w, h);
+      if (out == NULL) return NULL;
+      n = req_comp;
+   }
+   if (stbi__vertically_flip_on_load)
+      stbi__vertical_flip(out, (int) w, (int) h, n);
+   return out;
+}
+
+extern "C" stbi_uc *stbi_load(char const *filename, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   stbi_uc *buffer, *result;
+   long len;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) <= 0 || fseek(f, 0, SEEK_SET) != 0) {
+      fclose(f);
+      return stbi__stock_load(filename, x, y, comp, req_comp);
+   }
+   buffer = (stbi_uc *) STBI_MALLOC(len);
+   if (buffer == NULL || fread(buffer, 1, len, f) != (size_t) len) {
+      STBI_FREE(buffer);
+      fclose(f);
+      return stbi__stock_load(filename, x, y, comp, req_comp);
+   }
+   fclose(f);
+
+   result = stbi__fpng_load_from_memory(buffer, (size_t) len, x, y, comp, req_comp);
+   if (result == NULL)
+      result = stbi_load_from_memory(buffer, (int) len, x, y, comp, req_comp);
+   STBI_FREE(buffer);
+   return result;
+}